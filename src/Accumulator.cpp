@@ -0,0 +1,62 @@
+#include "Accumulator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+#include "libbin/bitmanip.hpp"
+
+namespace hdc {
+    Accumulator<Vector<bin_vec_t>>::Accumulator(dim_t dim) {
+        // Round the dimension the same way as the binary vector does
+        this->_acc.resize(Vector<bin_vec_t>(dim, false).size());
+    }
+
+    void Accumulator<Vector<bin_vec_t>>::add(VectorView<bin_vec_t> v, weight_t weight) {
+        _check_dim(v.size());
+        HDC_COUNT(bundle, v.words());
+        bitmanip::accumulate_weighted(v.data(), v.words(), weight, this->_acc.data());
+    }
+
+    void Accumulator<Vector<bin_vec_t>>::add(const RotatedView<bin_vec_t>& v, weight_t weight) {
+        _check_dim(v.size());
+        HDC_COUNT(bundle, v.words());
+
+        // The rotated words are gathered in blocks for the kernels
+        constexpr std::size_t BLOCK = 64;
+        std::array<bin_vec_t, BLOCK> block;
+        std::int32_t* acc = this->_acc.data();
+        v.for_each_word([&](std::size_t w, bin_vec_t word) {
+            block[w % BLOCK] = word;
+            if (w % BLOCK == BLOCK-1) {
+                bitmanip::accumulate_weighted(block.data(), BLOCK, weight, acc + (w-(BLOCK-1))*32);
+            }
+        });
+        const std::size_t tail = v.words() % BLOCK;
+        bitmanip::accumulate_weighted(block.data(), tail, weight, acc + (v.words()-tail)*32);
+    }
+
+    void Accumulator<Vector<bin_vec_t>>::merge(const Accumulator& other) {
+        _check_dim(other.size());
+        for (std::size_t i = 0; i < this->_acc.size(); i++) {
+            this->_acc[i] += other._acc[i];
+        }
+    }
+
+    void Accumulator<Vector<bin_vec_t>>::clear() {
+        std::fill(this->_acc.begin(), this->_acc.end(), 0);
+    }
+
+    Vector<bin_vec_t> Accumulator<Vector<bin_vec_t>>::result() const {
+        Vector<bin_vec_t> res(this->_acc.size(), false);
+        bitmanip::sign_pack(this->_acc.data(), res.words(), res.data());
+        return res;
+    }
+
+    void Accumulator<Vector<bin_vec_t>>::_check_dim(dim_t dim) const {
+        if (dim != this->_acc.size()) {
+            throw std::runtime_error("Attempt to accumulate a vector with "
+                                     "a different dimension.");
+        }
+    }
+}
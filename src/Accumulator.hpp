@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "OpCounters.hpp"
+#include "types.hpp"
+#include "Vector.hpp"
+#include "VectorView.hpp"
+
+namespace hdc {
+    /**
+     * @brief Per-dimension counters to bundle vectors one at a time.
+     *
+     * Adding vectors to an accumulator and taking its result is equivalent to
+     * calling hdc::add() on the list of vectors, without keeping the list.
+     * Subtracting a vector is equivalent to adding its inverse, so a class
+     * vector can be adapted without copying or inverting the vectors.
+     */
+    template<typename VectorType>
+    class Accumulator;
+
+    // Built-in type vectors. The counters hold the sum of the entries.
+    template<typename T>
+    class Accumulator<Vector<T>>
+    {
+    public:
+        using weight_t = T;
+
+        Accumulator(dim_t dim) : _acc(dim, 0) {}
+
+        dim_t size() const { return this->_acc.size(); }
+
+        void add(VectorView<T> v, weight_t weight=1) {
+            _check_dim(v.size());
+            HDC_COUNT(bundle, v.size());
+            const T* data = v.data();
+            for (std::size_t i = 0; i < this->_acc.size(); i++) {
+                this->_acc[i] += weight * data[i];
+            }
+        }
+
+        void add(const RotatedView<T>& v, weight_t weight=1) {
+            _check_dim(v.size());
+            HDC_COUNT(bundle, v.size());
+            v.for_each([this, weight](std::size_t i, T entry) {
+                this->_acc[i] += weight * entry;
+            });
+        }
+
+        // Remove a vector added before, or add its inverse
+        void subtract(VectorView<T> v) { this->add(v, -1); }
+        void subtract(const RotatedView<T>& v) { this->add(v, -1); }
+
+        void merge(const Accumulator& other) {
+            _check_dim(other.size());
+            for (std::size_t i = 0; i < this->_acc.size(); i++) {
+                this->_acc[i] += other._acc[i];
+            }
+        }
+
+        void clear() { std::fill(this->_acc.begin(), this->_acc.end(), 0); }
+
+        Vector<T> result() const {
+            Vector<T> res(this->_acc.size(), false);
+            std::copy(this->_acc.cbegin(), this->_acc.cend(), res.data());
+            return res;
+        }
+
+    private:
+        std::vector<T> _acc;
+
+        void _check_dim(dim_t dim) const {
+            if (dim != this->_acc.size()) {
+                throw std::runtime_error("Attempt to accumulate a vector with "
+                                         "a different dimension.");
+            }
+        }
+    };
+
+    // Binary vectors. Each bit adds its weight to the counter when set and
+    // subtracts it when cleared, so the result is the weighted majority.
+    template<>
+    class Accumulator<Vector<bin_vec_t>>
+    {
+    public:
+        using weight_t = std::int32_t;
+
+        Accumulator(dim_t dim);
+
+        dim_t size() const { return this->_acc.size(); }
+
+        void add(VectorView<bin_vec_t> v, weight_t weight=1);
+        void add(const RotatedView<bin_vec_t>& v, weight_t weight=1);
+        void subtract(VectorView<bin_vec_t> v) { this->add(v, -1); }
+        void subtract(const RotatedView<bin_vec_t>& v) { this->add(v, -1); }
+        void merge(const Accumulator& other);
+        void clear();
+        Vector<bin_vec_t> result() const;
+
+    private:
+        // Counter i*32+k holds the bit k of the packed word i
+        std::vector<std::int32_t> _acc;
+
+        void _check_dim(dim_t dim) const;
+    };
+}
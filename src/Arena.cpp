@@ -0,0 +1,52 @@
+#include "Arena.hpp"
+
+#include <cstddef>
+#include <memory_resource>
+
+namespace hdc {
+    Arena::Arena(std::size_t capacity) : _buffer(capacity) {
+        this->_resource.emplace(this->_buffer.data(), this->_buffer.size(), &this->_overflow);
+    }
+
+    void Arena::reset() {
+        if (!this->_overflow.bytes) {
+            this->_resource->release();
+            return;
+        }
+
+        // Make room for everything the last queries allocated
+        std::size_t capacity = this->_buffer.size() + this->_overflow.bytes;
+        this->_resource.reset();
+        this->_overflow.bytes = 0;
+        this->_buffer = std::vector<std::byte>(capacity);
+        this->_resource.emplace(this->_buffer.data(), this->_buffer.size(), &this->_overflow);
+    }
+
+    Arena& Arena::local() {
+        thread_local Arena arena;
+        return arena;
+    }
+
+    void* Arena::_Overflow::do_allocate(std::size_t bytes, std::size_t alignment) {
+        this->bytes += bytes;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void Arena::_Overflow::do_deallocate(void* p, std::size_t bytes, std::size_t alignment) {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool Arena::_Overflow::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+        return this == &other;
+    }
+
+    ScopedArena::ScopedArena() : _arena(Arena::local()) {
+        this->_arena._depth++;
+    }
+
+    ScopedArena::~ScopedArena() {
+        if (--this->_arena._depth == 0) {
+            this->_arena.reset();
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+namespace hdc {
+    /**
+     * @brief Monotonic memory for the temporaries of a query.
+     *
+     * Allocations take the next bytes of a buffer and deallocations do
+     * nothing. Everything is released at once by reset(). Allocations that do
+     * not fit in the buffer go to the heap, and the buffer grows on the next
+     * reset so that later queries of the same size do not call malloc().
+     */
+    class Arena
+    {
+    public:
+        Arena(std::size_t capacity=64*1024);
+        Arena(const Arena&)=delete;
+        Arena& operator=(const Arena&)=delete;
+
+        // Resource to give to the containers and vectors of a query
+        std::pmr::memory_resource* resource() { return &*this->_resource; }
+
+        // Release every allocation. Memory given by the arena must not be
+        // used after a reset.
+        void reset();
+
+        // Size of the buffer in bytes
+        std::size_t capacity() const { return this->_buffer.size(); }
+
+        // Arena of the calling thread, created on first use
+        static Arena& local();
+
+    private:
+        // Heap allocations of the arena, counted to resize the buffer
+        class _Overflow : public std::pmr::memory_resource
+        {
+        public:
+            std::size_t bytes = 0;
+
+        private:
+            void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+            void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+            bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+        };
+
+        std::vector<std::byte> _buffer;
+        _Overflow _overflow;
+        std::optional<std::pmr::monotonic_buffer_resource> _resource;
+        std::size_t _depth = 0;
+
+        friend class ScopedArena;
+    };
+
+    /**
+     * @brief Scope of a query on the arena of the calling thread.
+     *
+     * The arena is reset when the outermost scope of the thread ends, so
+     * nested scopes keep the memory of the enclosing ones. Vectors allocated
+     * from the arena must not outlive the scope.
+     */
+    class ScopedArena
+    {
+    public:
+        ScopedArena();
+        ScopedArena(const ScopedArena&)=delete;
+        ScopedArena& operator=(const ScopedArena&)=delete;
+        ~ScopedArena();
+
+        std::pmr::memory_resource* resource() const { return this->_arena.resource(); }
+
+    private:
+        Arena& _arena;
+    };
+}
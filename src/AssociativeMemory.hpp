@@ -1,9 +1,11 @@
 #pragma once
 
 #include <limits>
+#include <utility>
 #include <vector>
 
 #include "BaseMemory.hpp"
+#include "OpCounters.hpp"
 #include "types.hpp"
 #include "Vector.hpp"
 
@@ -15,25 +17,49 @@ namespace hdc {
         AssociativeMemory()=default;
         AssociativeMemory(const std::vector<VectorType>& am)
             : BaseMemory<VectorType>::BaseMemory(am) {}
+        AssociativeMemory(std::vector<VectorType>&& am)
+            : BaseMemory<VectorType>::BaseMemory(std::move(am)) {}
         AssociativeMemory(const std::string& path) : BaseMemory<VectorType>(path) {};
         AssociativeMemory(const char* path) : BaseMemory<VectorType>(path) {};
         virtual ~AssociativeMemory()=default;
 
         void clear() { this->_data.clear(); }
-        void emplace_back(VectorType v) { this->_data.emplace_back(v); }
+        void emplace_back(VectorType v) { this->_data.emplace_back(std::move(v)); }
 
-        std::size_t search(const VectorType& query) const {
+        // The query may be a Vector or a view of one
+        std::size_t search(typename VectorType::view_type query) const {
+            float margin;
+            return this->search(query, margin);
+        }
+
+        /**
+         * @brief Search the closest entry and measure how confident the
+         * answer is.
+         *
+         * @param query: Vector or view to search for.
+         * @param margin: Receives the distance from the query to the second
+         * closest entry minus its distance to the closest one.
+         * @return Index of the closest entry.
+         */
+        std::size_t search(typename VectorType::view_type query, float& margin) const {
+            HDC_COUNT(search, 0);
             std::size_t am_index = 0;
             float min_dist = std::numeric_limits<float>::infinity();
+            float second_dist = std::numeric_limits<float>::infinity();
 
-            for (int i = 0; i < this->_data.size(); i++) {
+            for (std::size_t i = 0; i < this->_data.size(); i++) {
                 auto new_dist = query.dist(this->_data[i]);
                 if (new_dist < min_dist) {
+                    second_dist = min_dist;
                     min_dist = new_dist;
                     am_index = i;
                 }
+                else if (new_dist < second_dist) {
+                    second_dist = new_dist;
+                }
             }
 
+            margin = second_dist - min_dist;
             return am_index;
         }
     };
@@ -4,8 +4,12 @@
 #include <filesystem>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
+#include "MappedFile.hpp"
+#include "OpCounters.hpp"
 #include "types.hpp"
 #include "Vector.hpp"
 
@@ -17,6 +21,7 @@ namespace hdc {
     protected:
         BaseMemory()=default;
         BaseMemory(const std::vector<T>& data) : _data(data) {};
+        BaseMemory(std::vector<T>&& data) : _data(std::move(data)) {};
         BaseMemory(const std::string& path) { this->load(path); };
         BaseMemory(const char* path) { this->load(path); };
         virtual ~BaseMemory()=default;
@@ -24,7 +29,15 @@ namespace hdc {
     public:
         std::size_t size() const { return this->_data.size(); }
 
-        const T at(std::size_t pos) const { return this->_data.at(pos); };
+        const T& at(std::size_t pos) const {
+            HDC_COUNT(lookup, 0);
+            return this->_data.at(pos);
+        };
+        // Unchecked access
+        const T& operator[](std::size_t pos) const {
+            HDC_COUNT(lookup, 0);
+            return this->_data[pos];
+        }
         const auto& back() const {
           return this->_data.back();
         };
@@ -54,24 +67,22 @@ namespace hdc {
                 throw std::runtime_error(msg);
             }
 
-            std::ifstream input_file(path);
-
-            if (!input_file.is_open()) {
-                std::string msg("Error when opening file: ");
-                msg += path;
-                throw std::runtime_error(msg);
-            }
+            // Map the model file and parse it in place instead of copying
+            // each line through a stream
+            MappedFile input_file(path);
+            std::string_view text = input_file.view();
 
             // Parse
-            std::string line;
-            while (!input_file.eof()) {
-                std::getline(input_file, line);
+            while (!text.empty()) {
+                auto end = text.find('\n');
+                std::string_view line = text.substr(0, end);
                 // The files should not contain any empty lines
                 if (line.empty()) {
                     break;
                 }
                 // Create a new hdc::Vector inside _data from the string in line
-                this->_data.emplace_back(line);
+                this->_data.emplace_back(std::string(line));
+                text.remove_prefix(end == std::string_view::npos ? text.size() : end+1);
             }
         }
 
@@ -0,0 +1,28 @@
+#include "BindingTable.hpp"
+
+#include <vector>
+
+#include "libbin/bitmanip.hpp"
+
+namespace hdc {
+    template<>
+    void BindingTable<Vector<bin_vec_t>>::encode_into(
+            Vector<bin_vec_t>& out,
+            const std::uint32_t* values,
+            std::size_t size
+            ) const {
+        check_record(this->_features, this->_levels, values, size);
+        check_output(out.size(), this->_dim);
+
+        // Rows selected by the record, reused between calls
+        thread_local std::vector<const bin_vec_t*> rows;
+        rows.resize(size);
+        for (std::size_t i = 0; i < size; i++) {
+            rows[i] = this->row(i, values[i]);
+        }
+
+        HDC_COUNT(lookup, 0, size);
+        HDC_COUNT(bundle, size*out.words());
+        bitmanip::majority(rows.data(), size, out.words(), size / 2, out.data());
+    }
+}
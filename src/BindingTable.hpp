@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+#include "BaseMemory.hpp"
+#include "Matrix.hpp"
+#include "OpCounters.hpp"
+#include "RecordEncoder.hpp"
+#include "ThreadPool.hpp"
+#include "types.hpp"
+#include "Vector.hpp"
+
+namespace hdc {
+    /**
+     * @brief Table of every binding between a feature ID and a level.
+     *
+     * Row i*levels + l holds ids[i] * levels[l], with the entries of the
+     * vector stored contiguously in a single matrix. A record is then encoded
+     * by bundling the rows selected by its values, which gives the same
+     * result as hdc::encode_record() without binding anything.
+     */
+    template<typename T>
+    class BindingTable
+    {
+    public:
+        // Type of the entries stored by the vectors
+        using entry_t = std::remove_const_t<std::remove_pointer_t<
+                decltype(std::declval<const T&>().data())>>;
+
+        BindingTable(const BaseMemory<T>& ids, const BaseMemory<T>& levels)
+            : _features(ids.size()), _levels(levels.size()), _dim(ids[0].size()) {
+            const std::size_t cols = std::distance(ids[0].cbegin(), ids[0].cend());
+            this->_table = Matrix<entry_t>(this->_features * this->_levels, cols);
+
+            // Rows are independent, so they are bound in parallel
+            ThreadPool::global().parallel_for(0, this->_table.rows(), [&](std::size_t r) {
+                T bound = ids[r / this->_levels];
+                bound.mul(levels[r % this->_levels]);
+                std::copy(bound.cbegin(), bound.cend(), this->_table.row(r));
+            }, 16);
+        }
+
+        std::size_t features() const { return this->_features; }
+        std::size_t levels() const { return this->_levels; }
+
+        const entry_t* row(std::size_t feature, std::uint32_t level) const {
+            return this->_table.row(feature * this->_levels + level);
+        }
+
+        /**
+         * @brief Encode a record of "size" features from the table rows into
+         * "out", reusing its storage.
+         */
+        void encode_into(T& out, const std::uint32_t* values, std::size_t size) const {
+            check_record(this->_features, this->_levels, values, size);
+            check_output(out.size(), this->_dim);
+
+            // Same blocking and summation order as hdc::encode_record()
+            constexpr std::size_t BLOCK = 1024;
+            entry_t* acc = out.data();
+            std::fill(acc, acc + this->_table.cols(), entry_t(0));
+            HDC_COUNT(lookup, 0, size);
+            HDC_COUNT(bundle, size*this->_table.cols());
+
+            for (std::size_t begin = 0; begin < this->_dim; begin += BLOCK) {
+                std::size_t end = std::min<std::size_t>(this->_dim, begin + BLOCK);
+                for (std::size_t i = 0; i < size; i++) {
+                    const entry_t* bound = this->row(i, values[i]);
+                    for (std::size_t d = begin; d < end; d++) {
+                        acc[d] += bound[d];
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief Encode a record of "size" features from the table rows.
+         */
+        T encode(const std::uint32_t* values, std::size_t size) const {
+            check_record(this->_features, this->_levels, values, size);
+            T res(this->_dim, false);
+            this->encode_into(res, values, size);
+            return res;
+        }
+
+        /**
+         * @brief Memory in bytes required by a table of the given shape.
+         */
+        static std::size_t footprint(std::size_t features, std::size_t levels, dim_t dim) {
+            T v(dim, false);
+            std::size_t bytes = std::distance(v.cbegin(), v.cend()) * sizeof(entry_t);
+            return features * levels * bytes;
+        }
+
+    private:
+        std::size_t _features;
+        std::size_t _levels;
+        dim_t _dim;
+        Matrix<entry_t> _table;
+    };
+
+    // Binary records are the bit majority of the selected rows
+    template<>
+    void BindingTable<Vector<bin_vec_t>>::encode_into(
+            Vector<bin_vec_t>& out,
+            const std::uint32_t* values,
+            std::size_t size
+            ) const;
+}
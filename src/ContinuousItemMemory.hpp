@@ -1,5 +1,6 @@
 #pragma once
 
+#include <utility>
 #include <vector>
 
 #include "BaseMemory.hpp"
@@ -19,7 +20,7 @@ namespace hdc {
                 // Copy the previous iteration vector and invert it
                 T v = this->_data[i-1];
                 v.invert(index, flips);
-                this->_data.emplace_back(v);
+                this->_data.emplace_back(std::move(v));
                 index += flips;
             }
         }
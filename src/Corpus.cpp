@@ -0,0 +1,17 @@
+#include "Corpus.hpp"
+
+#include "TextScan.hpp"
+
+namespace hdc {
+    Corpus::Corpus(const std::string& path) : _file(path) {
+        const char* p = this->_file.data();
+        const char* end = p + this->_file.size();
+
+        this->_lines.reserve(count_char(p, end, '\n') + 1);
+        while (p < end) {
+            const char* eol = find_char(p, end, '\n');
+            this->_lines.emplace_back(p, eol - p);
+            p = eol + 1;
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+namespace hdc {
+    /**
+     * @brief Text file mapped in memory and split in lines.
+     *
+     * Lines are views into the mapping without the newline character, so the
+     * file is never copied. The views are valid while the corpus exists.
+     */
+    class Corpus
+    {
+    public:
+        Corpus(const std::string& path);
+
+        std::size_t size() const { return this->_lines.size(); }
+        std::string_view operator[](std::size_t pos) const { return this->_lines[pos]; }
+
+        auto begin() const { return this->_lines.cbegin(); }
+        auto end() const { return this->_lines.cend(); }
+
+    private:
+        MappedFile _file;
+        std::vector<std::string_view> _lines;
+    };
+}
@@ -0,0 +1,54 @@
+#include "CsvReader.hpp"
+
+#include <algorithm>
+
+namespace hdc {
+    // Bytes of file per chunk given to the thread pool
+    static const std::size_t _CHUNK_BYTES = 1 << 20;
+
+    CsvReader::CsvReader(const std::string& path, char delimiter)
+        : _path(path), _delimiter(delimiter), _file(path) {
+        const char* begin = this->_file.data();
+        const char* end = begin + this->_file.size();
+
+        // Split the file in chunks that end right after a newline
+        for (const char* p = begin; p < end;) {
+            const char* stop = p + std::min(_CHUNK_BYTES, std::size_t(end - p));
+            stop = (stop < end) ? find_char(stop, end, '\n') : end;
+            stop = (stop < end) ? stop + 1 : end;
+            this->_chunks.push_back({p, stop, 0});
+            p = stop;
+        }
+
+        // Count the non empty lines of every chunk
+        std::vector<std::size_t> counts(this->_chunks.size(), 0);
+        ThreadPool::global().parallel_for(0, this->_chunks.size(), [&](std::size_t c) {
+            const Chunk& chunk = this->_chunks[c];
+            for (const char* p = chunk.begin; p < chunk.end;) {
+                const char* eol = find_char(p, chunk.end, '\n');
+                counts[c] += (_trim(p, eol) != p) ? 1 : 0;
+                p = eol + 1;
+            }
+        });
+        for (std::size_t c = 0; c < this->_chunks.size(); c++) {
+            this->_chunks[c].first_row = this->_rows;
+            this->_rows += counts[c];
+        }
+
+        // The first non empty line gives the number of columns
+        for (const char* p = begin; p < end && this->_rows > 0;) {
+            const char* eol = find_char(p, end, '\n');
+            const char* stop = _trim(p, eol);
+            if (stop != p) {
+                this->_cols = count_char(p, stop, this->_delimiter) + 1;
+                break;
+            }
+            p = eol + 1;
+        }
+    }
+
+    void CsvReader::_error(std::size_t row, const std::string& what) const {
+        throw std::runtime_error(this->_path + ": row " + std::to_string(row) +
+                                 ": " + what + ".");
+    }
+}
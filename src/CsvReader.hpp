@@ -0,0 +1,114 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "MappedFile.hpp"
+#include "Matrix.hpp"
+#include "TextScan.hpp"
+#include "ThreadPool.hpp"
+
+namespace hdc {
+    /**
+     * @brief Reader of delimiter separated numeric files.
+     *
+     * The file is mapped in memory and split in chunks that end at a newline.
+     * Rows of every chunk are counted and parsed in parallel with
+     * std::from_chars straight into a row-major Matrix. Empty lines are
+     * ignored and every other line must have the same number of columns as
+     * the first one.
+     */
+    class CsvReader
+    {
+    public:
+        CsvReader(const std::string& path, char delimiter=',');
+
+        std::size_t rows() const { return this->_rows; }
+        std::size_t cols() const { return this->_cols; }
+
+        template<typename T>
+        Matrix<T> read() const {
+            Matrix<T> m(this->_rows, this->_cols);
+            ThreadPool::global().parallel_for(0, this->_chunks.size(), [&](std::size_t c) {
+                const Chunk& chunk = this->_chunks[c];
+                std::size_t r = chunk.first_row;
+                const char* p = chunk.begin;
+                while (p < chunk.end) {
+                    const char* eol = find_char(p, chunk.end, '\n');
+                    const char* stop = _trim(p, eol);
+                    if (stop != p) {
+                        this->_parse_row(p, stop, m.row(r), r);
+                        r++;
+                    }
+                    p = eol + 1;
+                }
+            });
+            return m;
+        }
+
+    private:
+        // Newline aligned part of the file and index of its first row
+        struct Chunk {
+            const char* begin;
+            const char* end;
+            std::size_t first_row;
+        };
+
+        std::string _path;
+        char _delimiter;
+        MappedFile _file;
+        std::vector<Chunk> _chunks;
+        std::size_t _rows = 0;
+        std::size_t _cols = 0;
+
+        // End of a line without its carriage return
+        static const char* _trim(const char* begin, const char* end) {
+            return (end > begin && *(end-1) == '\r') ? end-1 : end;
+        }
+
+        static const char* _skip_blanks(const char* p, const char* end) {
+            while (p < end && (*p == ' ' || *p == '\t')) {
+                p++;
+            }
+            return p;
+        }
+
+        template<typename T>
+        void _parse_row(const char* p, const char* end, T* out, std::size_t row) const {
+            for (std::size_t c = 0; c < this->_cols; c++) {
+                p = _skip_blanks(p, end);
+                if (p < end && *p == '+') {
+                    p++;
+                }
+                auto [next, ec] = std::from_chars(p, end, out[c]);
+                if (ec != std::errc()) {
+                    this->_error(row, "invalid value in column " + std::to_string(c));
+                }
+                p = _skip_blanks(next, end);
+                if (c+1 < this->_cols) {
+                    if (p == end || *p != this->_delimiter) {
+                        this->_error(row, "expected " + std::to_string(this->_cols) + " columns");
+                    }
+                    p++;
+                }
+            }
+            if (p != end) {
+                this->_error(row, "expected " + std::to_string(this->_cols) + " columns");
+            }
+        }
+
+        [[noreturn]] void _error(std::size_t row, const std::string& what) const;
+    };
+
+    /**
+     * @brief Read a whole delimiter separated file into a matrix.
+     */
+    template<typename T>
+    Matrix<T> read_csv(const std::string& path, char delimiter=',') {
+        return CsvReader(path, delimiter).read<T>();
+    }
+}
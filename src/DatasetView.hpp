@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "MappedFile.hpp"
+#include "Matrix.hpp"
+
+namespace hdc {
+    /**
+     * @brief Read-only view of the records of a dataset.
+     *
+     * A record is a group of "cols" consecutive entries of type T. The
+     * entries live either in a mapped file or in a matrix owned by the view,
+     * and are shared by every view derived from it. Slicing, striding and
+     * selecting records create new views without copying any entry.
+     */
+    template<typename T>
+    class DatasetView
+    {
+    public:
+        DatasetView()=default;
+
+        // View every record of a binary file of records with "cols" entries
+        static DatasetView open(const std::string& path, std::size_t cols) {
+            auto file = std::make_shared<const MappedFile>(path);
+            const std::size_t record = cols * sizeof(T);
+            if (cols == 0 || file->size() % record != 0) {
+                throw std::runtime_error("Size of " + path + " is not a "
+                                         "multiple of the record size.");
+            }
+            return DatasetView(file, reinterpret_cast<const T*>(file->data()),
+                               file->size() / record, cols);
+        }
+
+        // View every row of a matrix, which is then owned by the view
+        static DatasetView own(Matrix<T> matrix) {
+            auto owned = std::make_shared<const Matrix<T>>(std::move(matrix));
+            return DatasetView(owned, owned->data(), owned->rows(), owned->cols());
+        }
+
+        std::size_t size() const { return this->_size; }
+        std::size_t cols() const { return this->_cols; }
+        bool empty() const { return this->_size == 0; }
+
+        // Entries of the record "pos" of the view
+        const T* operator[](std::size_t pos) const {
+            return this->_data + this->_record(pos) * this->_cols;
+        }
+
+        const T* at(std::size_t pos) const {
+            if (pos >= this->_size) {
+                throw std::out_of_range("Dataset view index out of range.");
+            }
+            return (*this)[pos];
+        }
+
+        /**
+         * @brief Entries of the view in a single block, or nullptr if the
+         * records of the view are not consecutive in memory.
+         */
+        const T* contiguous() const {
+            if (this->_indices || (this->_step != 1 && this->_size > 1)) {
+                return nullptr;
+            }
+            return (*this)[0];
+        }
+
+        // Records [begin, end) of the view
+        DatasetView slice(std::size_t begin, std::size_t end) const {
+            if (begin > end || end > this->_size) {
+                throw std::out_of_range("Dataset view slice out of range.");
+            }
+            DatasetView view(*this);
+            view._first = this->_first + begin * this->_step;
+            view._size = end - begin;
+            return view;
+        }
+
+        // Every "step"-th record of the view, starting from the first
+        DatasetView stride(std::size_t step) const {
+            if (step == 0) {
+                throw std::runtime_error("Dataset view stride must not be zero.");
+            }
+            DatasetView view(*this);
+            view._step = this->_step * step;
+            view._size = (this->_size + step - 1) / step;
+            return view;
+        }
+
+        // Records of the view at the given positions, in the given order
+        DatasetView select(const std::vector<std::size_t>& positions) const {
+            auto indices = std::make_shared<std::vector<std::size_t>>();
+            indices->reserve(positions.size());
+            for (auto pos : positions) {
+                if (pos >= this->_size) {
+                    throw std::out_of_range("Dataset view selection out of range.");
+                }
+                indices->emplace_back(this->_record(pos));
+            }
+
+            DatasetView view(*this);
+            view._indices = indices;
+            view._first = 0;
+            view._step = 1;
+            view._size = positions.size();
+            return view;
+        }
+
+    private:
+        // Keeps the mapping or the matrix alive
+        std::shared_ptr<const void> _owner;
+        const T* _data = nullptr;
+        std::size_t _cols = 0;
+
+        // Record "pos" of the view is record _first + pos*_step of the
+        // storage, or of the index list if there is one
+        std::shared_ptr<const std::vector<std::size_t>> _indices;
+        std::size_t _first = 0;
+        std::size_t _step = 1;
+        std::size_t _size = 0;
+
+        DatasetView(std::shared_ptr<const void> owner, const T* data,
+                    std::size_t size, std::size_t cols)
+            : _owner(std::move(owner)), _data(data), _cols(cols), _size(size) {}
+
+        std::size_t _record(std::size_t pos) const {
+            std::size_t idx = this->_first + pos * this->_step;
+            return this->_indices ? (*this->_indices)[idx] : idx;
+        }
+    };
+}
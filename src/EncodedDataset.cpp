@@ -0,0 +1,115 @@
+#include "EncodedDataset.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace hdc {
+    // The digit is the encoder version. Bump it when the encoders change
+    // their output for the same key, so stale cache files are encoded again.
+    // Version 2: binary p() is a rotation across words.
+    static const char _MAGIC[8] = {'H', 'D', 'C', 'E', 'N', 'C', '2', '\0'};
+    static const std::size_t _ALIGN = 64;
+
+    // Header stored at the beginning of an encoded dataset file, followed by
+    // the key
+    struct _Header {
+        char magic[8];
+        EncodedShape shape;
+        std::uint64_t key_size;
+    };
+
+    static std::size_t _data_offset(std::size_t key_size) {
+        std::size_t end = sizeof(_Header) + key_size;
+        return (end + _ALIGN - 1) / _ALIGN * _ALIGN;
+    }
+
+    void write_encoded(
+            const std::string& path,
+            const std::string& key,
+            const EncodedShape& shape,
+            const void* data
+            ) {
+        _Header header;
+        std::memcpy(header.magic, _MAGIC, sizeof(_MAGIC));
+        header.shape = shape;
+        header.key_size = key.size();
+
+        std::string tmp = path + ".tmp";
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        if (!f.is_open()) {
+            throw std::runtime_error("Could not create encoded dataset file: " + tmp);
+        }
+
+        std::size_t offset = _data_offset(key.size());
+        std::string padding(offset - sizeof(header) - key.size(), '\0');
+        f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        f.write(key.data(), key.size());
+        f.write(padding.data(), padding.size());
+        f.write(static_cast<const char*>(data), shape.rows * shape.cols * shape.entry_size);
+        f.close();
+        if (!f) {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("Failed to write encoded dataset file: " + tmp);
+        }
+
+        if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("Failed to write encoded dataset file: " + path);
+        }
+    }
+
+    std::size_t read_encoded(
+            const MappedFile& file,
+            const std::string& key,
+            EncodedShape& shape
+            ) {
+        _Header header;
+        if (file.size() < sizeof(header)) {
+            throw std::runtime_error("File is not an encoded dataset.");
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, _MAGIC, sizeof(_MAGIC)) != 0) {
+            throw std::runtime_error("File is not an encoded dataset.");
+        }
+
+        std::size_t offset = _data_offset(header.key_size);
+        if (file.size() < offset ||
+            file.view().substr(sizeof(header), header.key_size) != key) {
+            throw std::runtime_error("Encoded dataset was created with a "
+                                     "different key.");
+        }
+
+        shape = header.shape;
+        if (file.size() != offset + shape.rows * shape.cols * shape.entry_size) {
+            throw std::runtime_error("Encoded dataset file is truncated.");
+        }
+        return offset;
+    }
+
+    std::string encoded_cache_path(
+            const std::string& dir,
+            const std::string& name,
+            const std::string& key
+            ) {
+        // 64-bit FNV-1a
+        std::uint64_t hash = 0xcbf29ce484222325ULL;
+        for (unsigned char c : key) {
+            hash ^= c;
+            hash *= 0x100000001b3ULL;
+        }
+
+        std::ostringstream ss;
+        ss << dir << "/" << name << "-" << std::hex << std::setw(16)
+           << std::setfill('0') << hash << ".enc";
+        return ss.str();
+    }
+
+    std::string file_signature(const std::string& path) {
+        auto size = std::filesystem::file_size(path);
+        auto mtime = std::filesystem::last_write_time(path).time_since_epoch().count();
+        return path + ":" + std::to_string(size) + ":" + std::to_string(mtime);
+    }
+}
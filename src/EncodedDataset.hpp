@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "MappedFile.hpp"
+#include "Matrix.hpp"
+#include "ThreadPool.hpp"
+#include "types.hpp"
+
+namespace hdc {
+    // Shape of the vectors stored in an encoded dataset file
+    struct EncodedShape {
+        std::uint64_t entry_size;
+        std::uint64_t dim;
+        std::uint64_t rows;
+        std::uint64_t cols;
+    };
+
+    /**
+     * @brief Write an encoded dataset file.
+     *
+     * The file holds a header with the shape and the cache key followed by
+     * the rows, aligned to 64 bytes. It is written to a temporary file first
+     * and renamed, so readers never see a partial file.
+     */
+    void write_encoded(
+            const std::string& path,
+            const std::string& key,
+            const EncodedShape& shape,
+            const void* data
+            );
+
+    /**
+     * @brief Check a mapped encoded dataset file.
+     *
+     * @return Offset of the rows in the file.
+     * @throws std::runtime_error if the file is not an encoded dataset
+     * created with the same key and entry size.
+     */
+    std::size_t read_encoded(
+            const MappedFile& file,
+            const std::string& key,
+            EncodedShape& shape
+            );
+
+    /**
+     * @brief Path of the cache file of a dataset in "dir". The file name is
+     * derived from a hash of the key.
+     */
+    std::string encoded_cache_path(
+            const std::string& dir,
+            const std::string& name,
+            const std::string& key
+            );
+
+    /**
+     * @brief Path, size and modification time of a file, to tell cache keys
+     * of different versions of a dataset apart.
+     */
+    std::string file_signature(const std::string& path);
+
+    /**
+     * @brief Dataset encoded into hypervectors.
+     *
+     * The vectors are stored as rows of a single matrix. A dataset can be
+     * saved and mapped back from disk, in which case the rows are read
+     * straight from the mapping.
+     */
+    template<typename T>
+    class EncodedDataset
+    {
+    public:
+        // Type of the entries stored by the vectors
+        using entry_t = std::remove_const_t<std::remove_pointer_t<
+                decltype(std::declval<const T&>().data())>>;
+
+        /**
+         * @brief Encode "size" samples in parallel. encode(i) returns the
+         * vector of sample i.
+         */
+        template<typename Encode>
+        EncodedDataset(std::size_t size, dim_t dim, Encode encode, std::size_t grain=16)
+            : _dim(dim) {
+            T v(dim, false);
+            const std::size_t cols = std::distance(v.cbegin(), v.cend());
+            this->_owned = Matrix<entry_t>(size, cols);
+            this->_rows = size;
+            this->_cols = cols;
+            this->_data = this->_owned.data();
+
+            ThreadPool::global().parallel_for(0, size, [&](std::size_t i) {
+                T encoded = encode(i);
+                std::copy(encoded.cbegin(), encoded.cend(), this->_owned.row(i));
+            }, grain);
+        }
+
+        // Map a dataset saved with the same key
+        EncodedDataset(const std::string& path, const std::string& key)
+            : _mapped(std::in_place, path) {
+            EncodedShape shape;
+            std::size_t offset = read_encoded(*this->_mapped, key, shape);
+            if (shape.entry_size != sizeof(entry_t)) {
+                throw std::runtime_error("Encoded dataset " + path + " holds "
+                                         "a different vector type.");
+            }
+            this->_dim = shape.dim;
+            this->_rows = shape.rows;
+            this->_cols = shape.cols;
+            this->_data = reinterpret_cast<const entry_t*>(this->_mapped->data() + offset);
+        }
+
+        EncodedDataset(const EncodedDataset&)=delete;
+        EncodedDataset& operator=(const EncodedDataset&)=delete;
+        EncodedDataset(EncodedDataset&&)=default;
+        EncodedDataset& operator=(EncodedDataset&&)=default;
+
+        std::size_t size() const { return this->_rows; }
+        dim_t dim() const { return this->_dim; }
+        // Whether the vectors were mapped from a file instead of encoded
+        bool mapped() const { return this->_mapped.has_value(); }
+
+        const entry_t* row(std::size_t pos) const { return this->_data + pos * this->_cols; }
+
+        // View of the vector of sample "pos", valid while the dataset lives
+        typename T::view_type view(std::size_t pos) const {
+            if (pos >= this->_rows) {
+                throw std::out_of_range("Encoded dataset index out of range.");
+            }
+            return typename T::view_type(this->row(pos), this->_dim);
+        }
+
+        // Copy of the vector of sample "pos", allocated with "alloc"
+        T at(std::size_t pos, const typename T::allocator_type& alloc={}) const {
+            return T(this->view(pos), alloc);
+        }
+
+        void save(const std::string& path, const std::string& key) const {
+            EncodedShape shape{sizeof(entry_t), this->_dim, this->_rows, this->_cols};
+            write_encoded(path, key, shape, this->_data);
+        }
+
+        /**
+         * @brief Load the dataset from the cache in "dir" or encode it and
+         * store it there. An empty "dir" disables the cache.
+         *
+         * @param key: Description of everything the encoding depends on, such
+         * as the seed, the hyperparameters and the raw data.
+         */
+        template<typename Encode>
+        static EncodedDataset cached(
+                const std::string& dir,
+                const std::string& name,
+                const std::string& key,
+                std::size_t size,
+                dim_t dim,
+                Encode encode,
+                std::size_t grain=16
+                ) {
+            if (dir.empty()) {
+                return EncodedDataset(size, dim, encode, grain);
+            }
+
+            std::string path = encoded_cache_path(dir, name, key);
+            if (std::filesystem::is_regular_file(path)) {
+                try {
+                    EncodedDataset cache(path, key);
+                    if (cache.size() == size && cache.dim() == dim) {
+                        return cache;
+                    }
+                }
+                catch (const std::runtime_error&) {
+                    // Stale or foreign file, encode the dataset again
+                }
+            }
+
+            EncodedDataset encoded(size, dim, encode, grain);
+            std::filesystem::create_directories(dir);
+            encoded.save(path, key);
+            return encoded;
+        }
+
+    private:
+        dim_t _dim = 0;
+        std::size_t _rows = 0;
+        std::size_t _cols = 0;
+        Matrix<entry_t> _owned;
+        std::optional<MappedFile> _mapped;
+        // Rows of either the owned matrix or the mapping
+        const entry_t* _data = nullptr;
+    };
+}
@@ -0,0 +1,77 @@
+#include "MappedFile.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace hdc {
+    static std::runtime_error _mapping_error(const char* what, const char* path) {
+        std::string msg(what);
+        msg += ": ";
+        msg += path;
+        msg += " (";
+        msg += std::strerror(errno);
+        msg += ")";
+        return std::runtime_error(msg);
+    }
+
+    MappedFile::MappedFile(const char* path) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            throw _mapping_error("Error when opening file", path);
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            close(fd);
+            throw _mapping_error("Error when reading file size", path);
+        }
+        this->_size = st.st_size;
+
+        // mmap() does not accept zero-length mappings. An empty file is
+        // represented by a null pointer and size 0.
+        if (this->_size > 0) {
+            void* addr = mmap(nullptr, this->_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                close(fd);
+                throw _mapping_error("Error when mapping file", path);
+            }
+            // The data is scanned front to back by all readers
+            madvise(addr, this->_size, MADV_SEQUENTIAL);
+            this->_data = static_cast<const char*>(addr);
+        }
+
+        // The mapping stays valid after the descriptor is closed
+        close(fd);
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept
+        : _data(std::exchange(other._data, nullptr)),
+          _size(std::exchange(other._size, 0)) {}
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            this->_unmap();
+            this->_data = std::exchange(other._data, nullptr);
+            this->_size = std::exchange(other._size, 0);
+        }
+        return *this;
+    }
+
+    MappedFile::~MappedFile() { this->_unmap(); }
+
+    void MappedFile::_unmap() {
+        if (this->_data) {
+            munmap(const_cast<char*>(this->_data), this->_size);
+            this->_data = nullptr;
+            this->_size = 0;
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace hdc {
+    /**
+     * @brief Read-only memory mapping of a whole file. The mapping is released
+     * when the object is destroyed.
+     */
+    class MappedFile
+    {
+    public:
+        MappedFile(const std::string& path) : MappedFile(path.c_str()) {};
+        MappedFile(const char* path);
+        MappedFile(const MappedFile&)=delete;
+        MappedFile& operator=(const MappedFile&)=delete;
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+        ~MappedFile();
+
+        const char* data() const { return this->_data; }
+        std::size_t size() const { return this->_size; }
+        std::string_view view() const { return {this->_data, this->_size}; }
+
+    private:
+        const char* _data = nullptr;
+        std::size_t _size = 0;
+
+        void _unmap();
+    };
+}
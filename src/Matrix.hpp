@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+namespace hdc {
+    /**
+     * @brief Dense row-major matrix stored in a single contiguous buffer.
+     *
+     * Used to hold datasets where every row is a sample and every column a
+     * feature, so that a whole dataset is a single allocation.
+     */
+    template<typename T>
+    class Matrix
+    {
+    public:
+        Matrix() : _rows(0), _cols(0) {}
+        Matrix(std::size_t rows, std::size_t cols, const T& value=T())
+            : _rows(rows), _cols(cols), _data(rows * cols, value) {}
+
+        std::size_t rows() const { return this->_rows; }
+        std::size_t cols() const { return this->_cols; }
+        std::size_t size() const { return this->_data.size(); }
+        bool empty() const { return this->_data.empty(); }
+
+        T* data() { return this->_data.data(); }
+        const T* data() const { return this->_data.data(); }
+
+        // Pointer to the first element of a row
+        T* row(std::size_t r) { return this->_data.data() + r * this->_cols; }
+        const T* row(std::size_t r) const { return this->_data.data() + r * this->_cols; }
+
+        T& operator()(std::size_t r, std::size_t c) { return this->_data[r * this->_cols + c]; }
+        const T& operator()(std::size_t r, std::size_t c) const { return this->_data[r * this->_cols + c]; }
+
+        T& at(std::size_t r, std::size_t c) {
+            this->_check(r, c);
+            return (*this)(r, c);
+        }
+        const T& at(std::size_t r, std::size_t c) const {
+            this->_check(r, c);
+            return (*this)(r, c);
+        }
+
+        auto begin() { return this->_data.begin(); }
+        auto end() { return this->_data.end(); }
+        auto begin() const { return this->_data.cbegin(); }
+        auto end() const { return this->_data.cend(); }
+
+    private:
+        std::size_t _rows;
+        std::size_t _cols;
+        std::vector<T> _data;
+
+        void _check(std::size_t r, std::size_t c) const {
+            if (r >= this->_rows || c >= this->_cols) {
+                throw std::out_of_range("Matrix index out of range.");
+            }
+        }
+    };
+}
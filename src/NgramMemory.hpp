@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "EncodedDataset.hpp"
+#include "ItemMemory.hpp"
+#include "OpCounters.hpp"
+#include "ThreadPool.hpp"
+#include "types.hpp"
+
+namespace hdc {
+    /**
+     * @brief Table of every n-gram hypervector that can be built from an IM.
+     *
+     * Entry i holds the n-gram whose symbols are the base-"alphabet" digits of
+     * i, most significant symbol first. An n-gram is encoded as
+     * p(s_0, n-1) * p(s_1, n-2) * ... * s_{n-1}. The entries are the rows of
+     * an EncodedDataset, so a saved table is mapped back from disk and its
+     * rows are read as views without copying.
+     */
+    template<typename T>
+    class NgramMemory
+    {
+    public:
+        NgramMemory(const ItemMemory<T>& im, std::size_t n)
+            : _alphabet(im.size()), _n(n),
+              _table(entries(im.size(), n), im.at(0).size(),
+                     [this, &im](std::size_t i) {
+                         std::vector<std::size_t> symbols(this->_n);
+                         this->_symbols(i, symbols);
+                         return encode(im, symbols.data(), this->_n);
+                     }, 256) {}
+
+        // Map a table saved with save()
+        NgramMemory(const std::string& path, std::size_t alphabet, std::size_t n)
+            : _alphabet(alphabet), _n(n), _table(path, _key(alphabet, n)) {
+            if (this->size() != entries(alphabet, n)) {
+                throw std::runtime_error("N-gram table in " + path + " does not "
+                                         "match the given alphabet and n.");
+            }
+        }
+
+        NgramMemory(const NgramMemory&)=delete;
+        NgramMemory& operator=(const NgramMemory&)=delete;
+
+        std::size_t size() const { return this->_table.size(); }
+        std::size_t n() const { return this->_n; }
+        dim_t dim() const { return this->_table.dim(); }
+        // Whether the table was mapped from a file instead of encoded
+        bool mapped() const { return this->_table.mapped(); }
+
+        // View of entry "pos", valid while the table lives
+        typename T::view_type view(std::size_t pos) const {
+            HDC_COUNT(lookup, 0);
+            return this->_table.view(pos);
+        }
+
+        // Copy of entry "pos"
+        T at(std::size_t pos) const { return T(this->view(pos)); }
+
+        void save(const std::string& path) const {
+            this->_table.save(path, _key(this->_alphabet, this->_n));
+        }
+
+        /**
+         * @brief Table index of the n-gram formed by n symbols.
+         *
+         * @param symbols: IM indexes of the n-gram symbols.
+         * @return Position of the n-gram in the table.
+         */
+        template<typename S>
+        std::size_t index(const S* symbols) const {
+            std::size_t idx = 0;
+            for (std::size_t k = 0; k < this->_n; k++) {
+                if (static_cast<std::size_t>(symbols[k]) >= this->_alphabet) {
+                    throw std::out_of_range("Symbol outside of the n-gram "
+                                            "table alphabet.");
+                }
+                idx = idx * this->_alphabet + symbols[k];
+            }
+            return idx;
+        }
+
+        /**
+         * @brief Encode a single n-gram from the IM without using a table.
+         * The result is allocated with "alloc".
+         */
+        template<typename S>
+        static T encode(
+                const ItemMemory<T>& im,
+                const S* symbols,
+                std::size_t n,
+                const typename T::allocator_type& alloc={}
+                ) {
+            using rotated_t = typename T::rotated_type;
+            const T& first = im.at(symbols[0]);
+            T res(first.size(), false, alloc);
+            rotated_t(first, n-1).materialize(res);
+
+            // The other items are permuted while they are bound
+            for (std::size_t k = 1; k < n; k++) {
+                res.mul(rotated_t(im.at(symbols[k]), n-k-1));
+            }
+            return res;
+        }
+
+        static std::size_t entries(std::size_t alphabet, std::size_t n) {
+            std::size_t size = 1;
+            for (std::size_t k = 0; k < n; k++) {
+                size *= alphabet;
+            }
+            return size;
+        }
+
+        /**
+         * @brief Memory in bytes required by a table of the given shape.
+         */
+        static std::size_t footprint(std::size_t alphabet, std::size_t n, dim_t dim) {
+            T v(dim, false);
+            std::size_t bytes = std::distance(v.cbegin(), v.cend()) *
+                                sizeof(*v.cbegin());
+            return entries(alphabet, n) * bytes;
+        }
+
+    private:
+        std::size_t _alphabet;
+        std::size_t _n;
+        EncodedDataset<T> _table;
+
+        static std::string _key(std::size_t alphabet, std::size_t n) {
+            return "ngram alphabet=" + std::to_string(alphabet) +
+                   " n=" + std::to_string(n);
+        }
+
+        // Decompose a table index into its symbols
+        void _symbols(std::size_t idx, std::vector<std::size_t>& symbols) const {
+            for (std::size_t k = this->_n; k-- > 0;) {
+                symbols[k] = idx % this->_alphabet;
+                idx /= this->_alphabet;
+            }
+        }
+    };
+}
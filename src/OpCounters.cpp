@@ -0,0 +1,134 @@
+#include "OpCounters.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+namespace hdc {
+    namespace {
+        // Counters of one thread. Only the owner thread writes them, other
+        // threads read them when the totals are queried.
+        struct _thread_counts_t {
+            std::atomic<std::uint64_t> ops[OpCounters::ops] = {};
+            std::atomic<std::uint64_t> words[OpCounters::ops] = {};
+
+            _thread_counts_t();
+            ~_thread_counts_t();
+        };
+
+        struct _registry_t {
+            std::mutex mutex;
+            std::vector<_thread_counts_t*> threads;
+            // Counters of the threads that already exited
+            OpCounters::counts_t retired;
+        };
+
+        // Never destroyed, so threads that exit during the destruction of
+        // static objects (e.g. the thread pool) can still retire their counts
+        _registry_t& _registry() {
+            static _registry_t* registry = new _registry_t;
+            return *registry;
+        }
+
+        _thread_counts_t::_thread_counts_t() {
+            auto& registry = _registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.threads.push_back(this);
+        }
+
+        _thread_counts_t::~_thread_counts_t() {
+            auto& registry = _registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            for (int op = 0; op < OpCounters::ops; op++) {
+                registry.retired.ops[op] += this->ops[op].load(std::memory_order_relaxed);
+                registry.retired.words[op] += this->words[op].load(std::memory_order_relaxed);
+            }
+            registry.threads.erase(std::find(registry.threads.begin(),
+                                             registry.threads.end(), this));
+        }
+
+        _thread_counts_t& _local() {
+            thread_local _thread_counts_t counts;
+            return counts;
+        }
+
+        void _bump(std::atomic<std::uint64_t>& counter, std::uint64_t n) {
+            // Single writer, so no read-modify-write is needed
+            counter.store(counter.load(std::memory_order_relaxed) + n,
+                          std::memory_order_relaxed);
+        }
+    }
+
+    const char* OpCounters::name(op_t op) {
+        static const char* names[] = {
+            "bind", "bundle", "permute", "distance",
+            "lookup", "search", "alloc", "copy",
+        };
+        return names[op];
+    }
+
+    void OpCounters::add(op_t op, std::size_t words, std::size_t n) {
+        auto& counts = _local();
+        _bump(counts.ops[op], n);
+        _bump(counts.words[op], words);
+    }
+
+    OpCounters::counts_t OpCounters::total() {
+        auto& registry = _registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        counts_t res = registry.retired;
+        for (const auto* thread : registry.threads) {
+            for (int op = 0; op < ops; op++) {
+                res.ops[op] += thread->ops[op].load(std::memory_order_relaxed);
+                res.words[op] += thread->words[op].load(std::memory_order_relaxed);
+            }
+        }
+        return res;
+    }
+
+    void OpCounters::reset() {
+        auto& registry = _registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.retired = counts_t();
+        for (auto* thread : registry.threads) {
+            for (int op = 0; op < ops; op++) {
+                thread->ops[op].store(0, std::memory_order_relaxed);
+                thread->words[op].store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void OpCounters::report(std::ostream& os) {
+        auto flags = os.flags();
+        auto counts = total();
+        os << std::left << std::setw(12) << "op" << std::right
+            << std::setw(16) << "count"
+            << std::setw(16) << "words" << "\n";
+        for (int op = 0; op < ops; op++) {
+            os << std::left << std::setw(12) << name(static_cast<op_t>(op))
+                << std::right
+                << std::setw(16) << counts.ops[op]
+                << std::setw(16) << counts.words[op] << "\n";
+        }
+        os.flags(flags);
+    }
+
+    void OpCounters::report_json(std::ostream& os) {
+        if (!enabled()) {
+            os << "null";
+            return;
+        }
+
+        auto counts = total();
+        os << "{";
+        for (int op = 0; op < ops; op++) {
+            os << (op ? ", " : "")
+                << "\"" << name(static_cast<op_t>(op)) << "\": "
+                << "{\"count\": " << counts.ops[op] << ", "
+                << "\"words\": " << counts.words[op] << "}";
+        }
+        os << "}";
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace hdc {
+    /**
+     * @brief Number of HDC operations done by the program and the words of
+     * vector data they processed.
+     *
+     * Every thread counts in its own counters, which are added together when
+     * the totals are queried. The operations are only counted when the
+     * project is configured with -DHDC_OP_COUNTERS=ON. Otherwise HDC_COUNT()
+     * expands to nothing and the totals are always zero.
+     */
+    class OpCounters
+    {
+    public:
+        enum op_t {
+            bind,       // Vector::mul() and bound records
+            bundle,     // Vector::add() and accumulated vectors
+            permute,    // Vector::p()
+            distance,   // Vector::dist() and Vector::hamming()
+            lookup,     // Entries read from a memory
+            search,     // AssociativeMemory::search()
+            alloc,      // Vectors created
+            copy,       // Vectors copied
+            ops
+        };
+
+        struct counts_t {
+            std::uint64_t ops[op_t::ops] = {};
+            std::uint64_t words[op_t::ops] = {};
+        };
+
+        // Whether the counters were compiled in
+        static constexpr bool enabled() {
+#ifdef HDC_OP_COUNTERS
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        static const char* name(op_t op);
+
+        // Count n operations of the calling thread that processed "words"
+        // words of vector data in total
+        static void add(op_t op, std::size_t words, std::size_t n=1);
+
+        // Counters of all threads added together
+        static counts_t total();
+        static void reset();
+
+        static void report(std::ostream& os);
+        static void report_json(std::ostream& os);
+    };
+}
+
+#ifdef HDC_OP_COUNTERS
+#define HDC_COUNT(op, ...) ::hdc::OpCounters::add(::hdc::OpCounters::op, __VA_ARGS__)
+#else
+#define HDC_COUNT(op, ...) ((void)0)
+#endif
@@ -0,0 +1,126 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <ios>
+
+#include <sys/resource.h>
+
+#include "OpCounters.hpp"
+
+namespace hdc {
+    Profiler& Profiler::global() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    void Profiler::record(const phase_t& phase) {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        auto it = std::find_if(this->_phases.begin(), this->_phases.end(),
+                [&phase](const phase_t& p) { return p.name == phase.name; });
+        if (it == this->_phases.end()) {
+            this->_phases.emplace_back(phase);
+            return;
+        }
+        it->seconds += phase.seconds;
+        it->samples += phase.samples;
+        it->encodes += phase.encodes;
+        it->searches += phase.searches;
+    }
+
+    std::vector<Profiler::phase_t> Profiler::phases() const {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        return this->_phases;
+    }
+
+    double Profiler::elapsed() const {
+        return std::chrono::duration<double>(clock::now() - this->_start).count();
+    }
+
+    // Work per second, or zero if no work of that kind was done
+    static double _rate(std::size_t count, double seconds) {
+        return count && seconds > 0 ? count / seconds : 0.0;
+    }
+
+    static void _print_rate(std::ostream& os, std::size_t count, double seconds) {
+        if (count) {
+            os << std::setw(14) << _rate(count, seconds);
+        }
+        else {
+            os << std::setw(14) << "-";
+        }
+    }
+
+    void Profiler::report(std::ostream& os) const {
+        auto flags = os.flags();
+        os << std::left << std::setw(12) << "phase" << std::right
+            << std::setw(12) << "time (s)"
+            << std::setw(14) << "samples/s"
+            << std::setw(14) << "encodes/s"
+            << std::setw(14) << "searches/s" << "\n";
+
+        os << std::fixed << std::setprecision(3);
+        for (const auto& p : this->phases()) {
+            os << std::left << std::setw(12) << p.name << std::right
+                << std::setw(12) << p.seconds << std::setprecision(0);
+            _print_rate(os, p.samples, p.seconds);
+            _print_rate(os, p.encodes, p.seconds);
+            _print_rate(os, p.searches, p.seconds);
+            os << std::setprecision(3) << "\n";
+        }
+
+        os << "total: " << this->elapsed() << " s peak RSS: "
+            << std::setprecision(1) << peak_rss() / (1024.0 * 1024.0) << " MiB"
+            << std::endl;
+        os.flags(flags);
+
+        if (OpCounters::enabled()) {
+            OpCounters::report(os);
+        }
+    }
+
+    void Profiler::report_json(std::ostream& os, const std::string& app) const {
+        auto flags = os.flags();
+        os << std::fixed << std::setprecision(6);
+        os << "{\"app\": \"" << app << "\", "
+            << "\"total_seconds\": " << this->elapsed() << ", "
+            << "\"peak_rss_bytes\": " << peak_rss() << ", "
+            << "\"phases\": [";
+
+        auto phases = this->phases();
+        for (std::size_t i = 0; i < phases.size(); i++) {
+            const auto& p = phases[i];
+            os << (i ? ", " : "")
+                << "{\"name\": \"" << p.name << "\", "
+                << "\"seconds\": " << p.seconds << ", "
+                << "\"samples\": " << p.samples << ", "
+                << "\"samples_per_s\": " << _rate(p.samples, p.seconds) << ", "
+                << "\"encodes\": " << p.encodes << ", "
+                << "\"encodes_per_s\": " << _rate(p.encodes, p.seconds) << ", "
+                << "\"searches\": " << p.searches << ", "
+                << "\"searches_per_s\": " << _rate(p.searches, p.seconds) << "}";
+        }
+        os << "], \"op_counters\": ";
+        OpCounters::report_json(os);
+        os << "}" << std::endl;
+        os.flags(flags);
+    }
+
+    std::size_t Profiler::peak_rss() {
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) {
+            return 0;
+        }
+        // Linux reports the size in KiB
+        return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+    }
+
+    void ScopedTimer::stop() {
+        if (this->_stopped) {
+            return;
+        }
+        this->_stopped = true;
+        this->_phase.seconds = std::chrono::duration<double>(clock::now() - this->_start).count();
+        Profiler::global().record(this->_phase);
+    }
+}
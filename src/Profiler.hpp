@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace hdc {
+    /**
+     * @brief Wall time and amount of work of the phases of a program.
+     *
+     * Phases are recorded by ScopedTimer. Phases recorded more than once with
+     * the same name are added together and are reported in the order they
+     * were first recorded.
+     */
+    class Profiler
+    {
+    public:
+        struct phase_t {
+            std::string name;
+            double seconds = 0.0;
+            std::size_t samples = 0;
+            std::size_t encodes = 0;
+            std::size_t searches = 0;
+        };
+
+        // Profiler of the whole program, created on first use
+        static Profiler& global();
+
+        void record(const phase_t& phase);
+        std::vector<phase_t> phases() const;
+
+        // Seconds since the profiler was created
+        double elapsed() const;
+
+        // Table of the phases and their rates
+        void report(std::ostream& os) const;
+
+        /**
+         * @brief Report as a single JSON object. The keys and their order do
+         * not change between runs, so the output can be ingested by tools.
+         */
+        void report_json(std::ostream& os, const std::string& app) const;
+
+        // Peak resident set size of the process in bytes
+        static std::size_t peak_rss();
+
+    private:
+        using clock = std::chrono::steady_clock;
+
+        Profiler() : _start(clock::now()) {}
+
+        clock::time_point _start;
+        mutable std::mutex _mutex;
+        std::vector<phase_t> _phases;
+    };
+
+    /**
+     * @brief Measure the wall time of a scope and record it as a phase of
+     * the global profiler, along with the work done in it.
+     */
+    class ScopedTimer
+    {
+    public:
+        ScopedTimer(const std::string& name) : _start(clock::now()) {
+            this->_phase.name = name;
+        }
+        ScopedTimer(const ScopedTimer&)=delete;
+        ScopedTimer& operator=(const ScopedTimer&)=delete;
+        ~ScopedTimer() { this->stop(); }
+
+        void samples(std::size_t n) { this->_phase.samples += n; }
+        void encodes(std::size_t n) { this->_phase.encodes += n; }
+        void searches(std::size_t n) { this->_phase.searches += n; }
+
+        // Record the phase before the end of the scope
+        void stop();
+
+    private:
+        using clock = std::chrono::steady_clock;
+
+        Profiler::phase_t _phase;
+        clock::time_point _start;
+        bool _stopped = false;
+    };
+}
@@ -0,0 +1,144 @@
+#include "Quantizer.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#ifdef HDC_X86
+#include <immintrin.h>
+#endif
+
+#include "libbin/bitmanip.hpp"
+
+namespace hdc {
+    Quantizer::Quantizer(float min, float max, std::size_t levels)
+        : _min(min), _max(max), _levels(levels) {
+        if (levels == 0) {
+            throw std::runtime_error("Quantizer requires at least one level.");
+        }
+        if (!(max > min)) {
+            throw std::runtime_error("Quantizer requires max > min.");
+        }
+
+        this->_step = (max - min) / levels;
+        this->_bounds.resize(levels+1);
+        this->_bounds[0] = -std::numeric_limits<float>::infinity();
+        for (std::size_t i = 1; i < levels; i++) {
+            this->_bounds[i] = min + this->_step * i;
+        }
+        this->_bounds[levels] = std::numeric_limits<float>::infinity();
+    }
+
+    Quantizer Quantizer::fit(const float* data, std::size_t size, std::size_t levels) {
+        if (size == 0) {
+            throw std::runtime_error("Cannot fit a quantizer to empty data.");
+        }
+        auto range = std::minmax_element(data, data + size);
+        return Quantizer(*range.first, *range.second, levels);
+    }
+
+#ifdef HDC_X86
+    // Eight levels at once. Same steps as operator(), with the neighbouring
+    // boundaries gathered from the table. The AVX2 functions are compiled for
+    // AVX2 only and called when the binary kernels run on AVX2, so the
+    // library still runs on any x86-64 CPU.
+    __attribute__((target("avx2")))
+    static inline __m256i _quantize8(
+            __m256 value,
+            __m256 min,
+            __m256 step,
+            __m256 top,
+            const float* bounds) {
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256i zero = _mm256_setzero_si256();
+
+        __m256 guess = _mm256_div_ps(_mm256_sub_ps(value, min), step);
+        // max returns the second operand for NaN, which clamps it to 0
+        guess = _mm256_max_ps(guess, _mm256_setzero_ps());
+        guess = _mm256_min_ps(guess, top);
+        __m256i level = _mm256_cvttps_epi32(guess);
+
+        __m256 low = _mm256_i32gather_ps(bounds, level, 4);
+        __m256 high = _mm256_i32gather_ps(bounds, _mm256_add_epi32(level, one), 4);
+        __m256i down = _mm256_castps_si256(_mm256_cmp_ps(value, low, _CMP_LE_OQ));
+        __m256i up = _mm256_castps_si256(_mm256_cmp_ps(value, high, _CMP_GT_OQ));
+        down = _mm256_and_si256(down, _mm256_cmpgt_epi32(level, zero));
+
+        // Masks are -1 where true
+        level = _mm256_add_epi32(level, down);
+        level = _mm256_sub_epi32(level, _mm256_andnot_si256(down, up));
+        return level;
+    }
+
+    // Quantize the blocks of eight values of "in" and return how many values
+    // were quantized
+    __attribute__((target("avx2")))
+    static std::size_t _quantize_avx2(
+            const float* in,
+            std::size_t size,
+            std::uint32_t* out,
+            float min_value,
+            float step_value,
+            std::size_t levels,
+            const float* bounds) {
+        const __m256 min = _mm256_set1_ps(min_value);
+        const __m256 step = _mm256_set1_ps(step_value);
+        const __m256 top = _mm256_set1_ps(levels - 1);
+        std::size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            __m256i level = _quantize8(_mm256_loadu_ps(in+i), min, step, top, bounds);
+            _mm256_storeu_si256((__m256i*)(out+i), level);
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2")))
+    static std::size_t _quantize_avx2(
+            const double* in,
+            std::size_t size,
+            std::uint32_t* out,
+            float min_value,
+            float step_value,
+            std::size_t levels,
+            const float* bounds) {
+        const __m256 min = _mm256_set1_ps(min_value);
+        const __m256 step = _mm256_set1_ps(step_value);
+        const __m256 top = _mm256_set1_ps(levels - 1);
+        std::size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            __m256 value = _mm256_set_m128(
+                    _mm256_cvtpd_ps(_mm256_loadu_pd(in+i+4)),
+                    _mm256_cvtpd_ps(_mm256_loadu_pd(in+i)));
+            __m256i level = _quantize8(value, min, step, top, bounds);
+            _mm256_storeu_si256((__m256i*)(out+i), level);
+        }
+        return i;
+    }
+#endif
+
+    void Quantizer::quantize(const float* in, std::size_t size, std::uint32_t* out) const {
+        std::size_t i = 0;
+#ifdef HDC_X86
+        if (bitmanip::isa() == bitmanip::isa_t::avx2) {
+            i = _quantize_avx2(in, size, out, this->_min, this->_step,
+                               this->_levels, this->_bounds.data());
+        }
+#endif
+        for (; i < size; i++) {
+            out[i] = (*this)(in[i]);
+        }
+    }
+
+    void Quantizer::quantize(const double* in, std::size_t size, std::uint32_t* out) const {
+        std::size_t i = 0;
+#ifdef HDC_X86
+        if (bitmanip::isa() == bitmanip::isa_t::avx2) {
+            i = _quantize_avx2(in, size, out, this->_min, this->_step,
+                               this->_levels, this->_bounds.data());
+        }
+#endif
+        for (; i < size; i++) {
+            out[i] = (*this)(static_cast<float>(in[i]));
+        }
+    }
+}
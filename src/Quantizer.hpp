@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Matrix.hpp"
+
+namespace hdc {
+    /**
+     * @brief Map values of a range to one of "levels" equally sized bins.
+     *
+     * Level i holds the values in (min + step*i, min + step*(i+1)], the first
+     * level also holds everything below it and the last level everything
+     * above it. The bin boundaries are precomputed, so a level is found by
+     * estimating it from the value and correcting the estimate with at most
+     * one comparison against each neighbouring boundary.
+     */
+    class Quantizer
+    {
+    public:
+        Quantizer(float min, float max, std::size_t levels);
+
+        /**
+         * @brief Quantizer over the range of values found in "data".
+         */
+        static Quantizer fit(const float* data, std::size_t size, std::size_t levels);
+        static Quantizer fit(const Matrix<float>& data, std::size_t levels) {
+            return fit(data.data(), data.size(), levels);
+        }
+
+        float min() const { return this->_min; }
+        float max() const { return this->_max; }
+        std::size_t levels() const { return this->_levels; }
+
+        std::uint32_t operator()(float value) const {
+            float guess = (value - this->_min) / this->_step;
+            std::int32_t level = 0;
+            if (guess >= this->_levels - 1) {
+                level = this->_levels - 1;
+            }
+            else if (guess > 0) {
+                level = static_cast<std::int32_t>(guess);
+            }
+
+            // _bounds[level] is the lower boundary of the level
+            if (level > 0 && value <= this->_bounds[level]) {
+                level--;
+            }
+            else if (value > this->_bounds[level+1]) {
+                level++;
+            }
+            return level;
+        }
+
+        /**
+         * @brief Level of each of the "size" values of "in".
+         */
+        void quantize(const float* in, std::size_t size, std::uint32_t* out) const;
+        void quantize(const double* in, std::size_t size, std::uint32_t* out) const;
+
+        Matrix<std::uint32_t> quantize(const Matrix<float>& in) const {
+            Matrix<std::uint32_t> out(in.rows(), in.cols());
+            this->quantize(in.data(), in.size(), out.data());
+            return out;
+        }
+
+    private:
+        float _min;
+        float _max;
+        float _step;
+        std::size_t _levels;
+        // Level boundaries, -inf and +inf at the ends
+        std::vector<float> _bounds;
+    };
+}
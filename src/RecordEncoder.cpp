@@ -0,0 +1,70 @@
+#include "RecordEncoder.hpp"
+
+#include <string>
+#include <vector>
+
+#include "libbin/bitmanip.hpp"
+
+namespace hdc {
+    void check_record(
+            std::size_t ids,
+            std::size_t levels,
+            const std::uint32_t* values,
+            std::size_t size
+            ) {
+        if (size == 0) {
+            throw std::runtime_error("Attempt to encode an empty record.");
+        }
+        if (size > ids) {
+            throw std::out_of_range("Record has " + std::to_string(size) +
+                                    " features but only " + std::to_string(ids) +
+                                    " IDs are available.");
+        }
+        for (std::size_t i = 0; i < size; i++) {
+            if (values[i] >= levels) {
+                throw std::out_of_range("Record value outside of the level "
+                                        "memory.");
+            }
+        }
+    }
+
+    void check_output(dim_t out, dim_t dim) {
+        if (out != dim) {
+            throw std::runtime_error("Attempt to encode into a vector with a "
+                                     "different dimension.");
+        }
+    }
+
+    template<>
+    void encode_record_into(
+            Vector<bin_vec_t>& out,
+            const BaseMemory<Vector<bin_vec_t>>& ids,
+            const BaseMemory<Vector<bin_vec_t>>& levels,
+            const std::uint32_t* values,
+            std::size_t size
+            ) {
+        check_record(ids.size(), levels.size(), values, size);
+        check_output(out.size(), ids[0].size());
+
+        // Word arrays of the bound vectors, reused between calls
+        thread_local std::vector<const bin_vec_t*> id_words;
+        thread_local std::vector<const bin_vec_t*> level_words;
+        id_words.resize(size);
+        level_words.resize(size);
+        for (std::size_t i = 0; i < size; i++) {
+            id_words[i] = ids[i].data();
+            level_words[i] = levels[values[i]].data();
+        }
+
+        // One bind per feature and one bundle of all of them
+        HDC_COUNT(bind, 2*size*out.words(), size);
+        HDC_COUNT(bundle, size*out.words());
+        bitmanip::xor_majority(
+                id_words.data(),
+                level_words.data(),
+                size,
+                out.words(),
+                size / 2,
+                out.data());
+    }
+}
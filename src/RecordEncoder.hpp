@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "BaseMemory.hpp"
+#include "OpCounters.hpp"
+#include "types.hpp"
+#include "Vector.hpp"
+
+namespace hdc {
+    // Check that a record fits the given memories
+    void check_record(
+            std::size_t ids,
+            std::size_t levels,
+            const std::uint32_t* values,
+            std::size_t size
+            );
+
+    // Check that "out" can receive vectors of the given dimension
+    void check_output(dim_t out, dim_t dim);
+
+    /**
+     * @brief Encode a record of "size" features into "out", which must have
+     * the dimension of the memories.
+     *
+     * Feature i is bound to its ID as ids[i] * levels[values[i]] and all
+     * bindings are bundled. The result is the same as hdc::add() over the
+     * list of hdc::mul(ids.at(i), levels.at(values[i])), but the bindings
+     * are accumulated directly without creating temporary vectors. The
+     * storage of "out" is reused, so no memory is allocated.
+     */
+    template<typename T>
+    void encode_record_into(
+            Vector<T>& out,
+            const BaseMemory<Vector<T>>& ids,
+            const BaseMemory<Vector<T>>& levels,
+            const std::uint32_t* values,
+            std::size_t size
+            ) {
+        check_record(ids.size(), levels.size(), values, size);
+        check_output(out.size(), ids[0].size());
+
+        // The dimensions are processed in blocks that keep the sums in cache
+        // while every feature is added to them. Each entry still adds the
+        // features in order, as hdc::add() does.
+        constexpr std::size_t BLOCK = 1024;
+        const std::size_t dim = ids[0].size();
+        T* acc = out.data();
+        std::fill(acc, acc + dim, T(0));
+        // One bind per feature and one bundle of all of them
+        HDC_COUNT(bind, 2*size*dim, size);
+        HDC_COUNT(bundle, size*dim);
+
+        for (std::size_t begin = 0; begin < dim; begin += BLOCK) {
+            std::size_t end = std::min(dim, begin + BLOCK);
+            for (std::size_t i = 0; i < size; i++) {
+                const T* id = ids[i].data();
+                const T* level = levels[values[i]].data();
+                for (std::size_t d = begin; d < end; d++) {
+                    acc[d] += id[d] * level[d];
+                }
+            }
+        }
+    }
+
+    // Binary vectors bind with XOR and bundle with the bit majority
+    template<>
+    void encode_record_into(
+            Vector<bin_vec_t>& out,
+            const BaseMemory<Vector<bin_vec_t>>& ids,
+            const BaseMemory<Vector<bin_vec_t>>& levels,
+            const std::uint32_t* values,
+            std::size_t size
+            );
+
+    /**
+     * @brief Encode a record of "size" features into a new vector.
+     */
+    template<typename T>
+    Vector<T> encode_record(
+            const BaseMemory<Vector<T>>& ids,
+            const BaseMemory<Vector<T>>& levels,
+            const std::uint32_t* values,
+            std::size_t size
+            ) {
+        check_record(ids.size(), levels.size(), values, size);
+        Vector<T> res(ids[0].size(), false);
+        encode_record_into(res, ids, levels, values, size);
+        return res;
+    }
+}
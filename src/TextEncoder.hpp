@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+#include "Accumulator.hpp"
+#include "Arena.hpp"
+#include "ItemMemory.hpp"
+#include "NgramMemory.hpp"
+#include "TextNormalizer.hpp"
+#include "hdc.hpp"
+
+namespace hdc {
+    /**
+     * @brief Encode normalized text as the bundle of its n-grams.
+     *
+     * The n-grams are taken while there is a symbol after them, so the
+     * n-gram ending at the last symbol is not bundled. They are read from
+     * "table" when given, or encoded from the IM.
+     */
+    template<typename T>
+    T encode_text(
+            const ItemMemory<T>& im,
+            const NgramMemory<T>* table,
+            const std::uint8_t* symbols,
+            std::size_t size,
+            std::size_t n
+            ) {
+        // The n-grams only live until they are bundled
+        ScopedArena arena;
+        if (table) {
+            // Rows of the table are bundled in place
+            std::pmr::vector<typename T::view_type> n_grams(arena.resource());
+            n_grams.reserve(size);
+            for (std::size_t i = 0; i+n < size; i++) {
+                n_grams.emplace_back(table->view(table->index(symbols+i)));
+            }
+            return add(n_grams);
+        }
+
+        std::pmr::vector<T> n_grams(arena.resource());
+        n_grams.reserve(size);
+        for (std::size_t i = 0; i+n < size; i++) {
+            n_grams.emplace_back(NgramMemory<T>::encode(im, symbols+i, n, arena.resource()));
+        }
+        return add(n_grams);
+    }
+
+    /**
+     * @brief Encode a text given in chunks, as it arrives.
+     *
+     * The n-grams are bundled into an accumulator as soon as the symbol after
+     * them is known, and the normalizer state is carried between the chunks.
+     * After the whole text is fed, result() is equal to encode_text() over
+     * the normalized text.
+     */
+    template<typename T>
+    class TextStream
+    {
+    public:
+        TextStream(
+                const TextNormalizer& normalizer,
+                const ItemMemory<T>& im,
+                const NgramMemory<T>* table,
+                std::size_t n
+                ) : _normalizer(normalizer), _im(im), _table(table), _n(n),
+                    _acc(im.at(0).size()) {}
+
+        void feed(std::string_view chunk) {
+            this->_normalizer.normalize(chunk, this->_symbols, this->_last_separator);
+
+            const std::size_t n = this->_n;
+            std::size_t i = 0;
+            for (; i+n < this->_symbols.size(); i++, this->_ngrams++) {
+                const std::uint8_t* symbols = this->_symbols.data()+i;
+                if (this->_table) {
+                    this->_acc.add(this->_table->view(this->_table->index(symbols)));
+                }
+                else {
+                    ScopedArena arena;
+                    this->_acc.add(NgramMemory<T>::encode(this->_im, symbols, n, arena.resource()));
+                }
+            }
+            // Keep the symbols of the n-grams that are not complete yet
+            this->_symbols.erase(this->_symbols.begin(), this->_symbols.begin()+i);
+        }
+
+        // Number of n-grams bundled so far
+        std::size_t ngrams() const { return this->_ngrams; }
+
+        T result() const { return this->_acc.result(); }
+
+        void clear() {
+            this->_acc.clear();
+            this->_symbols.clear();
+            this->_last_separator = false;
+            this->_ngrams = 0;
+        }
+
+    private:
+        const TextNormalizer& _normalizer;
+        const ItemMemory<T>& _im;
+        const NgramMemory<T>* _table;
+        std::size_t _n;
+        Accumulator<T> _acc;
+        std::vector<std::uint8_t> _symbols;
+        bool _last_separator = false;
+        std::size_t _ngrams = 0;
+    };
+}
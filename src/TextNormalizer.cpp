@@ -0,0 +1,204 @@
+#include "TextNormalizer.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef HDC_X86
+#include <immintrin.h>
+#endif
+
+#include "libbin/bitmanip.hpp"
+
+namespace hdc {
+    static const std::uint8_t _LETTERS = 26;
+
+    TextNormalizer::TextNormalizer(bool collapse_separators)
+        : _separator(_LETTERS), _collapse(collapse_separators) {
+        this->_table.fill(this->_separator);
+        for (int c = 0; c < _LETTERS; c++) {
+            this->_table['a'+c] = c;
+            this->_table['A'+c] = c;
+        }
+    }
+
+    void TextNormalizer::map(unsigned char c, std::uint8_t symbol) {
+        if (symbol == SKIP) {
+            throw std::invalid_argument("Symbol index reserved for skipped bytes.");
+        }
+        this->_table[c] = symbol;
+        this->_default_table = false;
+    }
+
+    std::size_t TextNormalizer::alphabet() const {
+        std::size_t max = this->_separator;
+        for (auto symbol : this->_table) {
+            if (symbol != SKIP) {
+                max = std::max<std::size_t>(max, symbol);
+            }
+        }
+        return max + 1;
+    }
+
+    std::size_t TextNormalizer::_normalize_scalar(
+            const unsigned char* in,
+            std::size_t size,
+            std::uint8_t* out,
+            bool& last_separator
+            ) const {
+        std::size_t written = 0;
+        for (std::size_t i = 0; i < size; i++) {
+            std::uint8_t symbol = this->_table[in[i]];
+            if (symbol == SKIP) {
+                continue;
+            }
+            bool separator = symbol == this->_separator;
+            if (!(separator && last_separator && this->_collapse)) {
+                out[written++] = symbol;
+            }
+            last_separator = separator;
+        }
+        return written;
+    }
+
+    void TextNormalizer::normalize(std::string_view text, std::vector<std::uint8_t>& out) const {
+        bool last_separator = false;
+        this->normalize(text, out, last_separator);
+    }
+
+#ifdef HDC_X86
+    // Default table: fold ASCII to lower case with "| 0x20", then a byte is a
+    // letter if the folded value minus 'a' is lower than 26. This is exact
+    // since only A-Z and a-z fold into a-z. The blocks of 32 bytes of "in"
+    // are normalized into "dst", which is advanced, and the number of bytes
+    // consumed is returned. The function is compiled for AVX2 only and called
+    // when the binary kernels run on AVX2.
+    __attribute__((target("avx2")))
+    static std::size_t _normalize_avx2(
+            const unsigned char* in,
+            std::size_t size,
+            std::uint8_t*& dst,
+            std::uint8_t separator_symbol,
+            bool collapse,
+            bool& last_separator
+            ) {
+        const __m256i fold = _mm256_set1_epi8(0x20);
+        const __m256i first = _mm256_set1_epi8('a');
+        const __m256i letters = _mm256_set1_epi8(_LETTERS - 1);
+        const __m256i separator = _mm256_set1_epi8(separator_symbol);
+        alignas(32) std::uint8_t block[32];
+
+        std::size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            __m256i chunk = _mm256_loadu_si256((const __m256i*)(in + i));
+            __m256i index = _mm256_sub_epi8(_mm256_or_si256(chunk, fold), first);
+            // Unsigned "index <= 25" as "min(index, 25) == index"
+            __m256i is_letter = _mm256_cmpeq_epi8(_mm256_min_epu8(index, letters), index);
+            __m256i symbols = _mm256_blendv_epi8(separator, index, is_letter);
+
+            std::uint32_t sep_mask = ~(std::uint32_t)_mm256_movemask_epi8(is_letter);
+            // A separator is dropped when the previous byte is one too
+            std::uint32_t drop = 0;
+            if (collapse) {
+                drop = sep_mask & ((sep_mask << 1) | (last_separator ? 1 : 0));
+            }
+            last_separator = sep_mask >> 31;
+
+            if (!drop) {
+                _mm256_storeu_si256((__m256i*)dst, symbols);
+                dst += 32;
+            }
+            else {
+                _mm256_store_si256((__m256i*)block, symbols);
+                for (int k = 0; k < 32; k++) {
+                    if (!(drop & (1u << k))) {
+                        *dst++ = block[k];
+                    }
+                }
+            }
+        }
+        return i;
+    }
+#endif
+
+#if defined(HDC_X86) && defined(__SSE2__)
+    // Same as _normalize_avx2() with blocks of 16 bytes
+    static std::size_t _normalize_sse2(
+            const unsigned char* in,
+            std::size_t size,
+            std::uint8_t*& dst,
+            std::uint8_t separator_symbol,
+            bool collapse,
+            bool& last_separator
+            ) {
+        const __m128i fold = _mm_set1_epi8(0x20);
+        const __m128i first = _mm_set1_epi8('a');
+        const __m128i letters = _mm_set1_epi8(_LETTERS - 1);
+        const __m128i separator = _mm_set1_epi8(separator_symbol);
+        alignas(16) std::uint8_t block[16];
+
+        std::size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            __m128i chunk = _mm_loadu_si128((const __m128i*)(in + i));
+            __m128i index = _mm_sub_epi8(_mm_or_si128(chunk, fold), first);
+            __m128i is_letter = _mm_cmpeq_epi8(_mm_min_epu8(index, letters), index);
+            __m128i symbols = _mm_or_si128(_mm_and_si128(is_letter, index),
+                                           _mm_andnot_si128(is_letter, separator));
+
+            std::uint32_t sep_mask = ~(std::uint32_t)_mm_movemask_epi8(is_letter) & 0xFFFF;
+            std::uint32_t drop = 0;
+            if (collapse) {
+                drop = sep_mask & ((sep_mask << 1) | (last_separator ? 1 : 0));
+            }
+            last_separator = sep_mask >> 15;
+
+            if (!drop) {
+                _mm_storeu_si128((__m128i*)dst, symbols);
+                dst += 16;
+            }
+            else {
+                _mm_store_si128((__m128i*)block, symbols);
+                for (int k = 0; k < 16; k++) {
+                    if (!(drop & (1u << k))) {
+                        *dst++ = block[k];
+                    }
+                }
+            }
+        }
+        return i;
+    }
+#endif
+
+    void TextNormalizer::normalize(
+            std::string_view text,
+            std::vector<std::uint8_t>& out,
+            bool& last_separator
+            ) const {
+        auto in = reinterpret_cast<const unsigned char*>(text.data());
+        std::size_t size = text.size();
+        std::size_t start = out.size();
+        out.resize(start + size);
+        std::uint8_t* dst = out.data() + start;
+        std::size_t i = 0;
+
+        // Blocks are normalized with the instruction set of the binary
+        // kernels: AVX2 for avx2, SSE2 for sse4.2 and the table for scalar
+        if (this->_default_table) {
+#ifdef HDC_X86
+            const auto isa = bitmanip::isa();
+            if (isa == bitmanip::isa_t::avx2) {
+                i = _normalize_avx2(in, size, dst, this->_separator,
+                                    this->_collapse, last_separator);
+            }
+#endif
+#if defined(HDC_X86) && defined(__SSE2__)
+            if (isa == bitmanip::isa_t::sse42) {
+                i = _normalize_sse2(in, size, dst, this->_separator,
+                                    this->_collapse, last_separator);
+            }
+#endif
+        }
+
+        dst += this->_normalize_scalar(in + i, size - i, dst, last_separator);
+        out.resize(dst - out.data());
+    }
+}
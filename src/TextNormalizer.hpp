@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace hdc {
+    /**
+     * @brief Convert raw text into a stream of IM indexes.
+     *
+     * Every byte is translated through a 256-entry table. By default the
+     * letters a-z are folded to lower case and mapped to 0-25, and every other
+     * byte (digits, punctuation, whitespace, non-ASCII) is mapped to the
+     * separator symbol 26. Runs of separators can be collapsed into one. Bytes
+     * mapped to SKIP are dropped.
+     */
+    class TextNormalizer
+    {
+    public:
+        static const std::uint8_t SKIP = 0xFF;
+
+        TextNormalizer(bool collapse_separators=true);
+
+        // Map byte "c" to "symbol". Symbols must be lower than SKIP.
+        void map(unsigned char c, std::uint8_t symbol);
+
+        std::uint8_t separator() const { return this->_separator; }
+        void set_collapse(bool collapse) { this->_collapse = collapse; }
+
+        // Number of symbols produced, i.e., the IM size required
+        std::size_t alphabet() const;
+
+        /**
+         * @brief Normalize "text" and append its symbols to "out".
+         */
+        void normalize(std::string_view text, std::vector<std::uint8_t>& out) const;
+
+        /**
+         * @brief Normalize the next chunk of a text split in chunks.
+         * "last_separator" tells whether the last symbol written was a
+         * separator, and must start false, so runs of separators are
+         * collapsed across the chunks as in the whole text.
+         */
+        void normalize(
+                std::string_view text,
+                std::vector<std::uint8_t>& out,
+                bool& last_separator
+                ) const;
+
+    private:
+        std::array<std::uint8_t, 256> _table;
+        std::uint8_t _separator;
+        bool _collapse;
+        // The table still matches the default letters/separator classes, so
+        // the SIMD path can compute symbols arithmetically
+        bool _default_table = true;
+
+        std::size_t _normalize_scalar(
+                const unsigned char* in,
+                std::size_t size,
+                std::uint8_t* out,
+                bool& last_separator
+                ) const;
+    };
+}
@@ -0,0 +1,113 @@
+#include "TextScan.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef HDC_X86
+#include <immintrin.h>
+#endif
+
+#include "libbin/bitmanip.hpp"
+
+// The scans compare 32 (AVX2) or 16 (SSE2) bytes at once against the
+// searched character and use the comparison bitmask to locate it. The vector
+// width follows the instruction set of the binary kernels: AVX2 for avx2,
+// SSE2 for sse4.2 and the plain loops for scalar. The AVX2 functions are
+// compiled for AVX2 only, so the library still runs on any x86-64 CPU.
+namespace hdc {
+#ifdef HDC_X86
+    // Scan the blocks of 32 bytes from "p". Returns the character if it is
+    // found, otherwise nullptr with "p" at the first byte not scanned.
+    __attribute__((target("avx2")))
+    static const char* _find_avx2(const char*& p, const char* end, char c) {
+        const __m256i needle = _mm256_set1_epi8(c);
+        for (; p + 32 <= end; p += 32) {
+            __m256i chunk = _mm256_loadu_si256((const __m256i*)p);
+            std::uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+            if (mask) {
+                return p + __builtin_ctz(mask);
+            }
+        }
+        return nullptr;
+    }
+
+    __attribute__((target("avx2")))
+    static std::size_t _count_avx2(const char*& p, const char* end, char c) {
+        const __m256i needle = _mm256_set1_epi8(c);
+        std::size_t count = 0;
+        for (; p + 32 <= end; p += 32) {
+            __m256i chunk = _mm256_loadu_si256((const __m256i*)p);
+            std::uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+            count += __builtin_popcount(mask);
+        }
+        return count;
+    }
+#endif
+
+#if defined(HDC_X86) && defined(__SSE2__)
+    static const char* _find_sse2(const char*& p, const char* end, char c) {
+        const __m128i needle = _mm_set1_epi8(c);
+        for (; p + 16 <= end; p += 16) {
+            __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+            std::uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+            if (mask) {
+                return p + __builtin_ctz(mask);
+            }
+        }
+        return nullptr;
+    }
+
+    static std::size_t _count_sse2(const char*& p, const char* end, char c) {
+        const __m128i needle = _mm_set1_epi8(c);
+        std::size_t count = 0;
+        for (; p + 16 <= end; p += 16) {
+            __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+            std::uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+            count += __builtin_popcount(mask);
+        }
+        return count;
+    }
+#endif
+
+    const char* find_char(const char* begin, const char* end, char c) {
+        const char* p = begin;
+        const char* found = nullptr;
+#ifdef HDC_X86
+        const auto isa = bitmanip::isa();
+        if (isa == bitmanip::isa_t::avx2) {
+            found = _find_avx2(p, end, c);
+        }
+#endif
+#if defined(HDC_X86) && defined(__SSE2__)
+        if (isa == bitmanip::isa_t::sse42) {
+            found = _find_sse2(p, end, c);
+        }
+#endif
+        if (found) {
+            return found;
+        }
+        // Tail, or the whole range with the scalar kernels
+        const void* tail = std::memchr(p, c, end - p);
+        return tail ? static_cast<const char*>(tail) : end;
+    }
+
+    std::size_t count_char(const char* begin, const char* end, char c) {
+        const char* p = begin;
+        std::size_t count = 0;
+#ifdef HDC_X86
+        const auto isa = bitmanip::isa();
+        if (isa == bitmanip::isa_t::avx2) {
+            count = _count_avx2(p, end, c);
+        }
+#endif
+#if defined(HDC_X86) && defined(__SSE2__)
+        if (isa == bitmanip::isa_t::sse42) {
+            count = _count_sse2(p, end, c);
+        }
+#endif
+        for (; p < end; p++) {
+            count += *p == c;
+        }
+        return count;
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+
+namespace hdc {
+    /**
+     * @brief Find the first occurrence of "c" in [begin, end).
+     *
+     * @return Pointer to the character, or "end" if it is not found.
+     */
+    const char* find_char(const char* begin, const char* end, char c);
+
+    /**
+     * @brief Count the occurrences of "c" in [begin, end).
+     */
+    std::size_t count_char(const char* begin, const char* end, char c);
+}
@@ -0,0 +1,197 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace hdc {
+    struct ThreadPool::Job {
+        const std::function<void(std::size_t)>* body;
+        std::size_t pending;
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr error;
+    };
+
+    // Pool and queue index of the current thread when it is a pool worker
+    static thread_local const ThreadPool* _tls_pool = nullptr;
+    static thread_local std::size_t _tls_index = 0;
+
+    ThreadPool::ThreadPool(std::size_t threads) {
+        if (!threads) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        for (std::size_t i = 0; i < threads; i++) {
+            this->_queues.emplace_back(std::make_unique<Queue>());
+        }
+
+        // The calling thread is the last one of the pool
+        for (std::size_t i = 0; i+1 < threads; i++) {
+            this->_workers.emplace_back(&ThreadPool::_worker, this, i);
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(this->_mutex);
+            this->_stop = true;
+        }
+        this->_wakeup.notify_all();
+        for (auto& w : this->_workers) {
+            w.join();
+        }
+    }
+
+    void ThreadPool::parallel_for(
+            std::size_t begin,
+            std::size_t end,
+            const std::function<void(std::size_t)>& body,
+            std::size_t grain
+            ) {
+        if (begin >= end) {
+            return;
+        }
+
+        grain = grain ? grain : 1;
+        std::size_t chunks = (end - begin + grain - 1) / grain;
+
+        // Nothing to share, run in the calling thread
+        if (chunks == 1 || this->size() == 1) {
+            for (std::size_t i = begin; i < end; i++) {
+                body(i);
+            }
+            return;
+        }
+
+        Job job;
+        job.body = &body;
+        job.pending = chunks;
+
+        // Count the chunks before they can be popped, so that _queued never
+        // goes below zero. A worker that sees the count before the chunks are
+        // pushed only retries until they are.
+        this->_queued += chunks;
+
+        // Spread the chunks over all queues starting from the caller's own
+        std::size_t self = this->_self();
+        for (std::size_t c = 0; c < chunks; c++) {
+            std::size_t b = begin + c*grain;
+            Queue& q = *this->_queues[(self + c) % this->size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.tasks.push_back({&job, b, std::min(end, b+grain)});
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->_mutex);
+        }
+        this->_wakeup.notify_all();
+
+        // Help while the job is not finished
+        Task task;
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(job.mutex);
+                if (!job.pending) {
+                    break;
+                }
+            }
+            if (this->_pop(self, task)) {
+                this->_run(task);
+            }
+            else {
+                break;
+            }
+        }
+
+        // Remaining chunks are running in other threads
+        std::unique_lock<std::mutex> lock(job.mutex);
+        job.done.wait(lock, [&job]() { return job.pending == 0; });
+
+        if (job.error) {
+            std::rethrow_exception(job.error);
+        }
+    }
+
+    bool ThreadPool::_pop(std::size_t self, Task& task) {
+        // Take the oldest task of the own queue, otherwise steal the newest
+        // task of another queue
+        for (std::size_t i = 0; i < this->size(); i++) {
+            Queue& q = *this->_queues[(self + i) % this->size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty()) {
+                continue;
+            }
+            if (i == 0) {
+                task = q.tasks.front();
+                q.tasks.pop_front();
+            }
+            else {
+                task = q.tasks.back();
+                q.tasks.pop_back();
+            }
+            this->_queued--;
+            return true;
+        }
+        return false;
+    }
+
+    void ThreadPool::_run(const Task& task) {
+        Job& job = *task.job;
+        std::exception_ptr error;
+        try {
+            for (std::size_t i = task.begin; i < task.end; i++) {
+                (*job.body)(i);
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(job.mutex);
+        if (error && !job.error) {
+            job.error = error;
+        }
+        if (--job.pending == 0) {
+            job.done.notify_all();
+        }
+    }
+
+    void ThreadPool::_worker(std::size_t self) {
+        _tls_pool = this;
+        _tls_index = self;
+
+        Task task;
+        while (true) {
+            if (this->_pop(self, task)) {
+                this->_run(task);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(this->_mutex);
+            this->_wakeup.wait(lock, [this]() {
+                return this->_stop || this->_queued > 0;
+            });
+            if (this->_stop && this->_queued == 0) {
+                return;
+            }
+        }
+    }
+
+    std::size_t ThreadPool::_self() const {
+        return _tls_pool == this ? _tls_index : this->size()-1;
+    }
+
+    static std::unique_ptr<ThreadPool> _global_pool;
+    static std::mutex _global_mutex;
+
+    ThreadPool& ThreadPool::global() {
+        std::lock_guard<std::mutex> lock(_global_mutex);
+        if (!_global_pool) {
+            _global_pool = std::make_unique<ThreadPool>();
+        }
+        return *_global_pool;
+    }
+
+    void ThreadPool::set_threads(std::size_t threads) {
+        std::lock_guard<std::mutex> lock(_global_mutex);
+        _global_pool = std::make_unique<ThreadPool>(threads);
+    }
+}
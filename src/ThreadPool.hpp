@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace hdc {
+    /**
+     * @brief Work-stealing thread pool shared by the HDC applications.
+     *
+     * Ranges given to parallel_for() and parallel_reduce() are split in chunks
+     * of "grain" iterations. Chunks are spread over per-thread queues and idle
+     * threads steal chunks from the others. The calling thread also executes
+     * chunks while it waits, so nested calls do not deadlock.
+     */
+    class ThreadPool
+    {
+    public:
+        // A pool of "threads" threads, including the calling thread. Zero
+        // uses one thread per available core.
+        ThreadPool(std::size_t threads=0);
+        ThreadPool(const ThreadPool&)=delete;
+        ThreadPool& operator=(const ThreadPool&)=delete;
+        ~ThreadPool();
+
+        std::size_t size() const { return this->_queues.size(); }
+
+        /**
+         * @brief Execute body(i) for every i in [begin, end).
+         *
+         * The chunks only depend on "grain", not on the number of threads, so
+         * callers that keep per-chunk results give the same results for any
+         * --threads.
+         */
+        void parallel_for(
+                std::size_t begin,
+                std::size_t end,
+                const std::function<void(std::size_t)>& body,
+                std::size_t grain=1
+                );
+
+        /**
+         * @brief Reduce the range [begin, end) into a single value.
+         *
+         * Every chunk starts from a copy of "init" and calls map(partial, i)
+         * for its iterations. The partial results are then combined in chunk
+         * order with combine(result, partial). Chunks only depend on "grain",
+         * so the result does not depend on the number of threads.
+         */
+        template<typename T, typename Map, typename Combine>
+        T parallel_reduce(
+                std::size_t begin,
+                std::size_t end,
+                std::size_t grain,
+                const T& init,
+                Map map,
+                Combine combine
+                ) {
+            if (begin >= end) {
+                return init;
+            }
+
+            grain = grain ? grain : 1;
+            std::size_t chunks = (end - begin + grain - 1) / grain;
+            std::vector<std::unique_ptr<T>> partials(chunks);
+
+            this->parallel_for(0, chunks, [&](std::size_t c) {
+                auto partial = std::make_unique<T>(init);
+                std::size_t stop = std::min(end, begin + (c+1)*grain);
+                for (std::size_t i = begin + c*grain; i < stop; i++) {
+                    map(*partial, i);
+                }
+                partials[c] = std::move(partial);
+            });
+
+            T res = std::move(*partials[0]);
+            for (std::size_t c = 1; c < chunks; c++) {
+                combine(res, *partials[c]);
+            }
+            return res;
+        }
+
+        // Pool used by the applications
+        static ThreadPool& global();
+        static void set_threads(std::size_t threads);
+
+    private:
+        struct Job;
+        struct Task {
+            Job* job;
+            std::size_t begin;
+            std::size_t end;
+        };
+        struct Queue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        // One queue per thread. The last queue belongs to callers that are
+        // not pool threads.
+        std::vector<std::unique_ptr<Queue>> _queues;
+        std::vector<std::thread> _workers;
+
+        std::mutex _mutex;
+        std::condition_variable _wakeup;
+        std::atomic<std::size_t> _queued{0};
+        bool _stop = false;
+
+        bool _pop(std::size_t self, Task& task);
+        void _run(const Task& task);
+        void _worker(std::size_t self);
+        std::size_t _self() const;
+    };
+}
@@ -0,0 +1,136 @@
+#include "TransposedItemMemory.hpp"
+
+#include <vector>
+
+#ifdef HDC_X86
+#include <immintrin.h>
+#endif
+
+#include "ThreadPool.hpp"
+#include "libbin/bitmanip.hpp"
+
+namespace hdc {
+    TransposedItemMemory::TransposedItemMemory(
+            const BaseMemory<Vector<bin_vec_t>>& im,
+            std::uint32_t times
+            )
+        : _items(im.size()), _words(words(im.size())), _dim(im[0].size()) {
+        std::vector<Vector<bin_vec_t>> permuted;
+        for (std::size_t i = 0; i < this->_items; i++) {
+            permuted.emplace_back(im[i]);
+            permuted.back().p(times);
+        }
+
+        this->_columns = Matrix<std::uint64_t>(this->_dim, 2 * this->_words, 0);
+
+        // Each dimension only writes its own row, so rows are built in parallel
+        ThreadPool::global().parallel_for(0, this->_dim, [&](std::size_t d) {
+            std::uint64_t* col = this->_columns.row(d);
+            std::uint64_t* pcol = col + this->_words;
+            // Dimension d is the bit 31-d%32 of the word d/32
+            const std::size_t word = d / 32;
+            const std::size_t shift = 31 - d % 32;
+            for (std::size_t i = 0; i < this->_items; i++) {
+                std::uint64_t bit = (im[i].data()[word] >> shift) & 1;
+                std::uint64_t pbit = (permuted[i].data()[word] >> shift) & 1;
+                col[i / 64] |= bit << (i % 64);
+                pcol[i / 64] |= pbit << (i % 64);
+            }
+        }, 256);
+    }
+
+#ifdef HDC_X86
+    // Population count of each byte (Mula's nibble lookup). The AVX2
+    // functions are compiled for AVX2 only and called when the binary kernels
+    // run on AVX2.
+    __attribute__((target("avx2")))
+    static inline __m256i _popcount8(__m256i v) {
+        const __m256i lookup = _mm256_setr_epi8(
+                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i low = _mm256_set1_epi8(0x0f);
+        __m256i lo = _mm256_and_si256(v, low);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low);
+        return _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                               _mm256_shuffle_epi8(lookup, hi));
+    }
+
+    // Columns are padded to 256 bits, so "words" is a multiple of 4
+    __attribute__((target("avx2")))
+    static std::size_t _count_avx2(
+            const std::uint64_t* mask,
+            const std::uint64_t* col,
+            const std::uint64_t* pcol,
+            std::size_t words
+            ) {
+        std::size_t count = 0;
+        std::size_t w = 0;
+        // Byte counts are at most 16 per block, so 8 blocks fit in a byte
+        // before they are summed
+        while (w < words) {
+            __m256i bytes = _mm256_setzero_si256();
+            for (std::size_t blocks = 0; blocks < 8 && w < words; blocks++, w += 4) {
+                __m256i m = _mm256_loadu_si256((const __m256i*)(mask + w));
+                __m256i c = _mm256_loadu_si256((const __m256i*)(col + w));
+                __m256i p = _mm256_loadu_si256((const __m256i*)(pcol + w));
+                bytes = _mm256_add_epi8(bytes, _popcount8(_mm256_and_si256(m, c)));
+                bytes = _mm256_add_epi8(bytes, _popcount8(_mm256_andnot_si256(m, p)));
+            }
+            __m256i sums = _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+            __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sums),
+                                         _mm256_extracti128_si256(sums, 1));
+            count += _mm_cvtsi128_si64(half) + _mm_extract_epi64(half, 1);
+        }
+        return count;
+    }
+#endif
+
+    // Number of items selected by the mask whose dimension is set
+    static std::size_t _count(
+            const std::uint64_t* mask,
+            const std::uint64_t* col,
+            const std::uint64_t* pcol,
+            std::size_t words
+            ) {
+        std::size_t count = 0;
+        for (std::size_t w = 0; w < words; w++) {
+            count += __builtin_popcountll(mask[w] & col[w]);
+            count += __builtin_popcountll(~mask[w] & pcol[w]);
+        }
+        return count;
+    }
+
+    // Set the dimensions of "out" whose count is above the threshold
+    template<typename Count>
+    static void _encode(
+            Count count,
+            const Matrix<std::uint64_t>& columns,
+            const std::uint64_t* mask,
+            std::size_t words,
+            dim_t dim,
+            std::size_t threshold,
+            bin_vec_t* out
+            ) {
+        for (std::size_t d = 0; d < dim; d++) {
+            const std::uint64_t* col = columns.row(d);
+            if (count(mask, col, col + words, words) > threshold) {
+                out[d / 32] |= bin_vec_t(1) << (31 - d % 32);
+            }
+        }
+    }
+
+    Vector<bin_vec_t> TransposedItemMemory::encode(const std::uint64_t* mask) const {
+        Vector<bin_vec_t> res(this->_dim, false);
+        const std::size_t threshold = this->_items / 2;
+#ifdef HDC_X86
+        if (bitmanip::isa() == bitmanip::isa_t::avx2) {
+            _encode(_count_avx2, this->_columns, mask, this->_words, this->_dim,
+                    threshold, res.data());
+            return res;
+        }
+#endif
+        _encode(_count, this->_columns, mask, this->_words, this->_dim,
+                threshold, res.data());
+        return res;
+    }
+}
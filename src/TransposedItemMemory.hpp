@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "BaseMemory.hpp"
+#include "Matrix.hpp"
+#include "types.hpp"
+#include "Vector.hpp"
+
+namespace hdc {
+    /**
+     * @brief Binary IM stored by dimension to bundle items selected by a mask.
+     *
+     * Row d holds two bit columns of the items: bit i of the first one is
+     * dimension d of item i, and bit i of the second one is dimension d of
+     * the permuted item i. Bundling item i for every set bit i of a mask and
+     * the permuted item i for every cleared bit is then, for each dimension,
+     * popcount(mask & col) + popcount(~mask & permuted col) compared with the
+     * majority threshold.
+     */
+    class TransposedItemMemory
+    {
+    public:
+        TransposedItemMemory(const BaseMemory<Vector<bin_vec_t>>& im, std::uint32_t times=1);
+
+        // 64-bit words of a mask (and of a column) for the given items. Columns
+        // are padded to 256 bits.
+        static constexpr std::size_t words(std::size_t items) {
+            return (items + 255) / 256 * 4;
+        }
+
+        std::size_t size() const { return this->_items; }
+        dim_t dim() const { return this->_dim; }
+
+        /**
+         * @brief Bundle item i where bit i of "mask" is set and p(item i,
+         * times) where it is cleared.
+         *
+         * @param mask: words(size()) words, bit i of the mask is bit i%64 of
+         * word i/64.
+         */
+        Vector<bin_vec_t> encode(const std::uint64_t* mask) const;
+
+    private:
+        std::size_t _items;
+        std::size_t _words;
+        dim_t _dim;
+        // Row d holds the column of the items followed by the column of the
+        // permuted items
+        Matrix<std::uint64_t> _columns;
+    };
+}
@@ -1,12 +1,15 @@
 #include "Vector.hpp"
 #include "types.hpp"
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <stdexcept>
 #include "libbin/bitmanip.hpp"
 
 // Binary HDC: Binary Spatter Code (BSC) VSA
 namespace hdc {
-Vector<bin_vec_t>::Vector(dim_t dim, bool random) {
+Vector<bin_vec_t>::Vector(dim_t dim, bool random, const allocator_type& alloc)
+        : _data(alloc) {
         int bits = _sizeof_vec_t();
         // Find how many vec_t elements we need in the vector to support
         // the given dimension. The number of elements is ceiled to the
@@ -14,6 +17,7 @@ Vector<bin_vec_t>::Vector(dim_t dim, bool random) {
         int elements = dim / bits + (dim % bits != 0);
         this->_data.resize(elements);
         this->_dim = this->_data.size()*bits;
+        HDC_COUNT(alloc, this->_data.size());
 
         if (random) {
             this->_fillRandom(this->_data);
@@ -21,26 +25,21 @@ Vector<bin_vec_t>::Vector(dim_t dim, bool random) {
     }
 
 
-    Vector<bin_vec_t>::Vector(const std::string& str) {
-        this->_data = _unhex<bin_vec_t>(str);
+    Vector<bin_vec_t>::Vector(const std::string& str, const allocator_type& alloc)
+        : _data(alloc) {
+        auto words = _unhex<bin_vec_t>(str);
+        this->_data.assign(words.cbegin(), words.cend());
         int bits = _sizeof_vec_t();
         this->_dim = this->_data.size()*bits;
+        HDC_COUNT(alloc, this->_data.size());
     }
 
-    dim_t Vector<bin_vec_t>::hamming(const Vector<bin_vec_t>& rhs) const {
-        _check_size(this->_data, rhs._data);
-
-        dim_t res = 0;
-        for (int i = 0; i < this->_data.size(); i++) {
-            res += _popcount(this->_data[i] ^ rhs._data[i]);
-        }
-        return res;
+    dim_t Vector<bin_vec_t>::hamming(VectorView<bin_vec_t> rhs) const {
+        return VectorView<bin_vec_t>(*this).hamming(rhs);
     }
 
-    float Vector<bin_vec_t>::dist(const Vector<bin_vec_t>& rhs) const {
-        auto hamm_dist = this->hamming(rhs);
-
-        return (float)hamm_dist/(float)this->size();
+    float Vector<bin_vec_t>::dist(VectorView<bin_vec_t> rhs) const {
+        return VectorView<bin_vec_t>(*this).dist(rhs);
     }
 
     void Vector<bin_vec_t>::invert() {
@@ -79,35 +78,113 @@ Vector<bin_vec_t>::Vector(dim_t dim, bool random) {
     }
 
     void Vector<bin_vec_t>::p(std::uint32_t times) {
-        // Get HV's most significant bit (MSB)
-        bool hv_msb = _get_bit(this->_data[0], _sizeof_vec_t()-1);
-        bool next_msb;
-
-        for (std::uint32_t p = 0; p < times; p++) {
-            for (int i = 0; i < this->_data.size(); i++) {
-                next_msb = _get_bit(this->_data[i+1], _sizeof_vec_t()-1);
-                if (i == this->_data.size()-1) {
-                    next_msb = hv_msb;
-                }
-                this->_data[i] <<= 1 | (next_msb ? 1 : 0);
+        HDC_COUNT(permute, this->_data.size());
+        if (this->_data.empty()) {
+            return;
+        }
+
+        // Rotate towards the lower dimensions: whole words first, then the
+        // remaining bits with a funnel shift that wraps around the end
+        const int bits = _sizeof_vec_t();
+        const dim_t offset = times % this->_dim;
+        std::rotate(this->_data.begin(), this->_data.begin() + offset / bits, this->_data.end());
+
+        const int s = offset % bits;
+        if (s) {
+            const bin_vec_t first = this->_data[0];
+            const std::size_t last = this->_data.size() - 1;
+            for (std::size_t i = 0; i < last; i++) {
+                this->_data[i] = (this->_data[i] << s) | (this->_data[i+1] >> (bits - s));
             }
+            this->_data[last] = (this->_data[last] << s) | (first >> (bits - s));
+        }
+    }
+
+    void Vector<bin_vec_t>::add(VectorView<bin_vec_t> v1, VectorView<bin_vec_t> v2) {
+        MutableVectorView<bin_vec_t>(*this).add(v1, v2);
+    }
+
+    void Vector<bin_vec_t>::mul(VectorView<bin_vec_t> rhs) {
+        MutableVectorView<bin_vec_t>(*this).mul(rhs);
+    }
+
+    void Vector<bin_vec_t>::mul(const RotatedView<bin_vec_t>& rhs) {
+        MutableVectorView<bin_vec_t>(*this).mul(rhs);
+    }
+
+    int VectorView<bin_vec_t>::get(dim_t pos) const {
+        if (pos >= this->_dim) {
+            throw std::out_of_range("Vector view index out of range.");
         }
+        int bits = sizeof(bin_vec_t) * 8;
+        return (this->_data[pos / bits] >> (bits - pos % bits - 1)) & 1;
+    }
+
+    dim_t VectorView<bin_vec_t>::hamming(VectorView<bin_vec_t> rhs) const {
+        _check_dim(this->_dim, rhs._dim);
+        HDC_COUNT(distance, 2*this->words());
+
+        return bitmanip::hamming(this->_data, rhs._data, this->words());
     }
 
-    void Vector<bin_vec_t>::add(const Vector& v1, const Vector& v2) {
+    float VectorView<bin_vec_t>::dist(VectorView<bin_vec_t> rhs) const {
+        auto hamm_dist = this->hamming(rhs);
+
+        return (float)hamm_dist/(float)this->size();
+    }
+
+    dim_t RotatedView<bin_vec_t>::hamming(VectorView<bin_vec_t> rhs) const {
+        _check_dim(this->size(), rhs.size());
+        HDC_COUNT(distance, 2*this->words());
+
+        // The rotated words are gathered in blocks for the popcount kernels
+        constexpr std::size_t BLOCK = 64;
+        std::array<bin_vec_t, BLOCK> block;
+        const bin_vec_t* r = rhs.data();
+        dim_t res = 0;
+        this->for_each_word([&](std::size_t w, bin_vec_t word) {
+            block[w % BLOCK] = word;
+            if (w % BLOCK == BLOCK-1) {
+                res += bitmanip::hamming(block.data(), r + w - (BLOCK-1), BLOCK);
+            }
+        });
+        const std::size_t tail = this->words() % BLOCK;
+        res += bitmanip::hamming(block.data(), r + this->words() - tail, tail);
+        return res;
+    }
+
+    float RotatedView<bin_vec_t>::dist(VectorView<bin_vec_t> rhs) const {
+        auto hamm_dist = this->hamming(rhs);
+
+        return (float)hamm_dist/(float)this->size();
+    }
+
+    void RotatedView<bin_vec_t>::materialize(MutableVectorView<bin_vec_t> out) const {
+        _check_dim(out.size(), this->size());
+        HDC_COUNT(permute, this->words(), 0);
+        bin_vec_t* data = out.data();
+        this->for_each_word([data](std::size_t w, bin_vec_t word) { data[w] = word; });
+    }
+
+    void MutableVectorView<bin_vec_t>::add(VectorView<bin_vec_t> v1, VectorView<bin_vec_t> v2) const {
+        _check_dim(this->_dim, v1.size());
+        _check_dim(this->_dim, v2.size());
         const bin_vec_t *a, *b, *c;
+        HDC_COUNT(bundle, 3*this->words());
 
-        for (int i = 0; i < this->_data.size(); i++) {
+        for (std::size_t i = 0; i < this->words(); i++) {
             a = &this->_data[i];
-            b = &v1._data[i];
-            c = &v2._data[i];
+            b = &v1.data()[i];
+            c = &v2.data()[i];
             this->_data[i] = (*a & *b) | (*b & *c) | (*c & *a);
         }
     }
 
-    Vector<bin_vec_t> Vector<bin_vec_t>::add(
-            const std::vector<Vector<bin_vec_t>> vectors
-            ) {
+    static bin_vec_t _word(VectorView<bin_vec_t> v, std::size_t w) { return v.data()[w]; }
+    static bin_vec_t _word(const RotatedView<bin_vec_t>& v, std::size_t w) { return v.word(w); }
+
+    template<typename V>
+    void MutableVectorView<bin_vec_t>::add(const V* vectors, std::size_t n) const {
         // Simple implementation
         //auto dim = vectors[0].size();
         //std::vector<unsigned int> acc(dim);
@@ -126,17 +203,20 @@ Vector<bin_vec_t>::Vector(dim_t dim, bool random) {
         // Explore data locality implementation
         constexpr uint32_t vec_t_size = sizeof(hdc::bin_vec_t)*8;
         std::array<uint32_t, vec_t_size> acc;
-        Vector<bin_vec_t> res(vectors[0].size(), false);
         // The bit_group refers to the vec_t entries in the vector data
-        const std::size_t bit_groups = vectors[0]._data.size();
+        const std::size_t bit_groups = this->words();
+        HDC_COUNT(bundle, n*bit_groups);
+        for (std::size_t k = 0; k < n; k++) {
+            _check_dim(this->_dim, vectors[k].size());
+        }
 
         for (std::size_t i = 0; i < bit_groups; i++) {
             // Reset the accumulator
             for (int i = 0; i < vec_t_size; i++) { acc[i] = 0; }
 
             // Accumulate the bits of the same bit_group of all vectors
-            for (const auto &hv : vectors) {
-                hdc::bin_vec_t bit_group = hv._data[i];
+            for (std::size_t k = 0; k < n; k++) {
+                hdc::bin_vec_t bit_group = _word(vectors[k], i);
                 // Unpack bits into accumulator
                 //for (std::size_t pos = 0; pos < vec_t_size; pos++) {
                 //    acc[pos] += bitmanip::get_bit(bit_group, pos);
@@ -148,7 +228,7 @@ Vector<bin_vec_t>::Vector(dim_t dim, bool random) {
             hdc::bin_vec_t res_bit_group = 0;
             for (std::size_t pos = 0; pos < vec_t_size; pos++) {
                 // Decide the bit majority of the accumulator entries
-                int threshold = vectors.size() / 2;
+                int threshold = n / 2;
                 hdc::bin_vec_t bit = acc[vec_t_size-pos-1] > threshold;
                 // Set bit
                 res_bit_group <<= 1;
@@ -156,16 +236,29 @@ Vector<bin_vec_t>::Vector(dim_t dim, bool random) {
             }
             //uint32_t threshold = vectors.size() / 2;
             //auto res_bit_group = bitmanip::threshold_pack(acc, threshold);
-            res._data[i] = res_bit_group;
+            this->_data[i] = res_bit_group;
         }
-
-        return res;
     }
 
-    void Vector<bin_vec_t>::mul(const Vector& rhs) {
-        for (int i = 0; i < this->_data.size(); i++) {
-            this->_data[i] = this->_data[i] ^ rhs._data[i];
+    // Bundles are only defined for lists of vectors and of views
+    template void MutableVectorView<bin_vec_t>::add(const Vector<bin_vec_t>*, std::size_t) const;
+    template void MutableVectorView<bin_vec_t>::add(const VectorView<bin_vec_t>*, std::size_t) const;
+    template void MutableVectorView<bin_vec_t>::add(const RotatedView<bin_vec_t>*, std::size_t) const;
+
+    void MutableVectorView<bin_vec_t>::mul(VectorView<bin_vec_t> rhs) const {
+        _check_dim(this->_dim, rhs.size());
+        HDC_COUNT(bind, 2*this->words());
+        const bin_vec_t* r = rhs.data();
+        for (std::size_t i = 0; i < this->words(); i++) {
+            this->_data[i] = this->_data[i] ^ r[i];
         }
     }
 
+    void MutableVectorView<bin_vec_t>::mul(const RotatedView<bin_vec_t>& rhs) const {
+        _check_dim(this->_dim, rhs.size());
+        HDC_COUNT(bind, 2*this->words());
+        bin_vec_t* data = this->_data;
+        rhs.for_each_word([data](std::size_t w, bin_vec_t word) { data[w] ^= word; });
+    }
+
 };
@@ -5,10 +5,13 @@
 #include <cmath>
 #include <cstdlib>
 #include <iomanip>
+#include <memory_resource>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
+#include "OpCounters.hpp"
+#include "VectorView.hpp"
 #include "types.hpp"
 
 namespace hdc {
@@ -34,38 +37,81 @@ namespace hdc {
         return v;
     }
 
-    template<typename T>
-    static void _check_size(const std::vector<T>& a, const std::vector<T>& b) {
-        if (a.size() != b.size()) {
-          throw std::runtime_error("Attempt to perform operation on vectors "
-                                   "with different dimensions.");
-        }
-    }
-
     // Built-in type vectors
     template<typename T>
     class Vector
     {
     public:
-        Vector(dim_t dim, bool random=true) {
+        // The entries are allocated from a memory resource, the default one
+        // unless an allocator is given. Copies use the default resource.
+        using allocator_type = std::pmr::polymorphic_allocator<T>;
+        using view_type = VectorView<T>;
+        using rotated_type = RotatedView<T>;
+
+        Vector(dim_t dim, bool random=true, const allocator_type& alloc={})
+            : _data(alloc) {
+            HDC_COUNT(alloc, dim);
             this->_data.resize(dim);
             if (random) {
                 this->_fillRandom(this->_data);
             }
         }
 
-        Vector(const std::string& str) { this->_data = _unhex<T>(str); }
+        Vector(const std::string& str, const allocator_type& alloc={})
+            : _data(alloc) {
+            auto entries = _unhex<T>(str);
+            this->_data.assign(entries.cbegin(), entries.cend());
+            HDC_COUNT(alloc, this->_data.size());
+        }
+
+        Vector(const Vector& other) : Vector(other, allocator_type()) {}
+
+        Vector(const Vector& other, const allocator_type& alloc)
+            : _data(other._data, alloc) {
+            HDC_COUNT(copy, this->_data.size());
+        }
+
+        // Copy of the vector seen by a view
+        explicit Vector(VectorView<T> view, const allocator_type& alloc={})
+            : _data(view.cbegin(), view.cend(), alloc) {
+            HDC_COUNT(copy, this->_data.size());
+        }
+
+        Vector& operator=(const Vector& other) {
+            HDC_COUNT(copy, other._data.size());
+            this->_data = other._data;
+            return *this;
+        }
+
+        // Moves take the storage of the other vector, which is left empty
+        Vector(Vector&& other) noexcept=default;
+
+        // The storage is only taken when both vectors use the same resource,
+        // otherwise the entries are copied, which may throw
+        Vector& operator=(Vector&& other) {
+            if (this->get_allocator() != other.get_allocator()) {
+                HDC_COUNT(copy, other._data.size());
+            }
+            this->_data = std::move(other._data);
+            return *this;
+        }
+
+        // The storage is only taken when it comes from the same resource
+        Vector(Vector&& other, const allocator_type& alloc)
+            : _data(std::move(other._data), alloc) {}
 
         virtual ~Vector(){};
 
+        allocator_type get_allocator() const { return this->_data.get_allocator(); }
+
+        // Views of the vector, valid while it is not resized or destroyed
+        operator VectorView<T>() const { return VectorView<T>(this->data(), this->size()); }
+        operator MutableVectorView<T>() { return MutableVectorView<T>(this->data(), this->size()); }
+
         dim_t size() const { return this->_data.size(); }
 
-        float dist(const Vector& v) const {
-            float c = this->_cos(v);
-            // Adjust cosine value to be between 0.0 and 1.0 as required by
-            // BaseVector::dist(). A value close to 0 means that both vectors
-            // are similar
-            return std::abs((1.0-c)/2.0);
+        float dist(VectorView<T> v) const {
+            return VectorView<T>(*this).dist(v);
         }
 
         void invert() {
@@ -83,64 +129,67 @@ namespace hdc {
         }
 
         void p(std::uint32_t times=1) {
-            for (std::uint32_t i = 0; i < times; i++) {
-                // Rotate right
-                std::rotate(
-                        this->_data.rbegin(),
-                        this->_data.rbegin()+1,
-                        this->_data.rend()
-                        );
+            HDC_COUNT(permute, this->size());
+            if (this->_data.empty()) {
+                return;
             }
+            // Rotate right
+            std::rotate(
+                    this->_data.rbegin(),
+                    this->_data.rbegin() + times % this->_data.size(),
+                    this->_data.rend()
+                    );
         }
 
-        void add(const Vector& v1, const Vector& v2) {
-            for (std::size_t i = 0; i < this->size(); i++) {
-                this->_data[i] += v1._data[i] + v2._data[i];
-            }
+        void add(VectorView<T> v1, VectorView<T> v2) {
+            MutableVectorView<T>(*this).add(v1, v2);
         }
 
+        // Bundle of a list of Vectors or VectorViews
+        template<typename V, typename Alloc>
         static Vector<T> add(
-                const std::vector<Vector<T>> vectors
+                const std::vector<V, Alloc>& vectors
                 ) {
-            auto dim = vectors[0].size();
-            Vector<T> res(dim, false);
+            Vector<T> res(vectors[0].size(), false);
+            add_into(res, vectors);
+            return res;
+        }
 
-            for (std::size_t d = 0; d < dim; d++) {
-                for (std::size_t i = 0; i < vectors.size(); i++) {
-                    res._data[d] += vectors[i].get(d);
-                }
-            }
+        // Bundle into "out", which must not be one of the bundled vectors
+        template<typename V, typename Alloc>
+        static void add_into(
+                Vector<T>& out,
+                const std::vector<V, Alloc>& vectors
+                ) {
+            out._data.resize(vectors[0].size());
+            add_into(MutableVectorView<T>(out), vectors);
+        }
 
-            return res;
+        template<typename V, typename Alloc>
+        static void add_into(
+                MutableVectorView<T> out,
+                const std::vector<V, Alloc>& vectors
+                ) {
+            out.add(vectors.data(), vectors.size());
         }
 
-        void mul(const Vector& rhs) {
-            for (std::size_t i = 0; i < this->size(); i++) {
-                this->_data[i] *= rhs._data[i];
-            }
+        void mul(VectorView<T> rhs) {
+            MutableVectorView<T>(*this).mul(rhs);
+        }
+
+        void mul(const RotatedView<T>& rhs) {
+            MutableVectorView<T>(*this).mul(rhs);
         }
 
         auto cbegin() const { return std::cbegin(this->_data); }
         auto cend() const { return std::cend(this->_data); }
 
-    private:
-        std::vector<T> _data;
-
-        float _cos(const Vector& v) const {
-            float magnitude_a = 0.0;
-            float magnitude_b = 0.0;
-            float dot_product = 0.0;
-
-            for (auto i = 0; i < this->_data.size(); i++) {
-                float a = this->_data[i];
-                float b = v._data[i];
-                dot_product += a*b;
-                magnitude_a += a*a;
-                magnitude_b += b*b;
-            }
+        // Raw access to the vector entries for kernels
+        T* data() { return this->_data.data(); }
+        const T* data() const { return this->_data.data(); }
 
-            return dot_product / (std::sqrt(magnitude_a) * std::sqrt(magnitude_b));
-        }
+    private:
+        std::pmr::vector<T> _data;
 
         static T _generateRandomNumber() {
             // Generate -1 or 1 randomly
@@ -151,7 +200,7 @@ namespace hdc {
             return (T)-1;
         }
 
-        void _fillRandom(std::vector<T>& v) {
+        void _fillRandom(std::pmr::vector<T>& v) {
             //Generate unit vectors
             std::generate(v.begin(), v.end(), _generateRandomNumber);
         }
@@ -162,31 +211,110 @@ namespace hdc {
     class Vector<bin_vec_t>
     {
     public:
-        Vector(dim_t dim, bool random=true) ;
-        Vector(const std::string& str);
+        using allocator_type = std::pmr::polymorphic_allocator<bin_vec_t>;
+        using view_type = VectorView<bin_vec_t>;
+        using rotated_type = RotatedView<bin_vec_t>;
+
+        Vector(dim_t dim, bool random=true, const allocator_type& alloc={});
+        Vector(const std::string& str, const allocator_type& alloc={});
+
+        Vector(const Vector& other) : Vector(other, allocator_type()) {}
+
+        Vector(const Vector& other, const allocator_type& alloc)
+            : _dim(other._dim), _data(other._data, alloc) {
+            HDC_COUNT(copy, this->_data.size());
+        }
+
+        explicit Vector(VectorView<bin_vec_t> view, const allocator_type& alloc={})
+            : _dim(view.size()), _data(view.cbegin(), view.cend(), alloc) {
+            HDC_COUNT(copy, this->_data.size());
+        }
+
+        Vector& operator=(const Vector& other) {
+            HDC_COUNT(copy, other._data.size());
+            this->_dim = other._dim;
+            this->_data = other._data;
+            return *this;
+        }
+
+        // Moves take the storage of the other vector, which is left empty
+        Vector(Vector&& other) noexcept=default;
+
+        // The storage is only taken when both vectors use the same resource,
+        // otherwise the entries are copied, which may throw
+        Vector& operator=(Vector&& other) {
+            if (this->get_allocator() != other.get_allocator()) {
+                HDC_COUNT(copy, other._data.size());
+            }
+            this->_dim = other._dim;
+            this->_data = std::move(other._data);
+            return *this;
+        }
+
+        Vector(Vector&& other, const allocator_type& alloc)
+            : _dim(other._dim), _data(std::move(other._data), alloc) {}
 
         virtual ~Vector()=default;
 
+        allocator_type get_allocator() const { return this->_data.get_allocator(); }
+
+        // Views of the vector, valid while it is not resized or destroyed
+        operator VectorView<bin_vec_t>() const {
+            return VectorView<bin_vec_t>(this->data(), this->size());
+        }
+        operator MutableVectorView<bin_vec_t>() {
+            return MutableVectorView<bin_vec_t>(this->data(), this->size());
+        }
+
         dim_t size() const { return this->_dim; }
-        dim_t hamming(const Vector<bin_vec_t>& rhs) const;
-        float dist(const Vector<bin_vec_t>& rhs) const;
+        dim_t hamming(VectorView<bin_vec_t> rhs) const;
+        float dist(VectorView<bin_vec_t> rhs) const;
         void invert();
         void invert(dim_t start, dim_t inversions);
         int get(dim_t pos) const;
         void set(dim_t pos, int val);
         void p(std::uint32_t times);
-        void add(const Vector& v1, const Vector& v2);
+        void add(VectorView<bin_vec_t> v1, VectorView<bin_vec_t> v2);
+        // Bundle of a list of Vectors or VectorViews
+        template<typename V, typename Alloc>
         static Vector<bin_vec_t> add(
-                const std::vector<Vector<bin_vec_t>> vectors
-                );
-        void mul(const Vector& rhs);
+                const std::vector<V, Alloc>& vectors
+                ) {
+            Vector<bin_vec_t> res(vectors[0].size(), false);
+            add_into(res, vectors);
+            return res;
+        }
+        // Bundle into "out", which must not be one of the bundled vectors
+        template<typename V, typename Alloc>
+        static void add_into(
+                Vector<bin_vec_t>& out,
+                const std::vector<V, Alloc>& vectors
+                ) {
+            out._dim = vectors[0].size();
+            out._data.resize(_bin_words(out._dim));
+            add_into(MutableVectorView<bin_vec_t>(out), vectors);
+        }
+        template<typename V, typename Alloc>
+        static void add_into(
+                MutableVectorView<bin_vec_t> out,
+                const std::vector<V, Alloc>& vectors
+                ) {
+            out.add(vectors.data(), vectors.size());
+        }
+        void mul(VectorView<bin_vec_t> rhs);
+        void mul(const RotatedView<bin_vec_t>& rhs);
 
         auto cbegin() const { return std::cbegin(this->_data); }
         auto cend() const { return std::cend(this->_data); }
 
+        // Raw access to the packed words for kernels
+        bin_vec_t* data() { return this->_data.data(); }
+        const bin_vec_t* data() const { return this->_data.data(); }
+        std::size_t words() const { return this->_data.size(); }
+
     private:
         dim_t _dim;
-        std::vector<bin_vec_t> _data;
+        std::pmr::vector<bin_vec_t> _data;
 
         // Return the size of vec_t in bits
         int _sizeof_vec_t() const { return sizeof(bin_vec_t) * 8; }
@@ -212,22 +340,14 @@ namespace hdc {
 
         bin_vec_t _get_bit_position(dim_t pos) const { return pos % _sizeof_vec_t(); }
 
-        int _popcount(bin_vec_t val) const {
-            int pop = 0;
-            for (int i = 0; i < _sizeof_vec_t(); i++) {
-                pop += _get_bit(val, i) ? 1 : 0;
-            }
-            return pop;
-        }
-
-        void _fillRandom(std::vector<bin_vec_t>& v) const {
+        void _fillRandom(std::pmr::vector<bin_vec_t>& v) const {
             std::generate(v.begin(), v.end(), rand);
         }
     };
 }
 
 template<typename VectorType>
-std::ostream& operator<<(std::ostream& os, const hdc::Vector<VectorType> v) {
+std::ostream& operator<<(std::ostream& os, const hdc::Vector<VectorType>& v) {
     for (auto it = v.cbegin(); it != v.cend(); it++) {
         os << std::hex << std::setw(8) << std::setfill('0') << *it;
     }
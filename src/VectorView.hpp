@@ -0,0 +1,379 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "OpCounters.hpp"
+#include "types.hpp"
+
+namespace hdc {
+    static inline void _check_dim(dim_t a, dim_t b) {
+        if (a != b) {
+            throw std::runtime_error("Attempt to perform operation on vectors "
+                                     "with different dimensions.");
+        }
+    }
+
+    // Words of a binary vector of dimension "dim", rounded up as for Vector
+    static inline std::size_t _bin_words(dim_t dim) {
+        constexpr dim_t bits = sizeof(bin_vec_t) * 8;
+        return dim / bits + (dim % bits != 0);
+    }
+
+    /**
+     * @brief Read-only hypervector over memory that it does not own, such as
+     * a mapped model file, a receive buffer or a row of a matrix.
+     *
+     * A view is a pointer and a dimension and is passed by value. The memory
+     * must outlive the view. Vector converts to a view without copying, so
+     * the operations that take views also take vectors.
+     */
+    template<typename T>
+    class VectorView
+    {
+    public:
+        VectorView(const T* data, dim_t dim) : _data(data), _dim(dim) {}
+
+        dim_t size() const { return this->_dim; }
+        const T* data() const { return this->_data; }
+
+        const T* cbegin() const { return this->_data; }
+        const T* cend() const { return this->_data + this->_dim; }
+
+        T get(std::size_t pos) const {
+            if (pos >= this->_dim) {
+                throw std::out_of_range("Vector view index out of range.");
+            }
+            return this->_data[pos];
+        }
+
+        float dist(VectorView v) const {
+            _check_dim(this->_dim, v._dim);
+            HDC_COUNT(distance, 2*this->_dim);
+            float c = this->_cos(v);
+            // Adjust cosine value to be between 0.0 and 1.0 as required by
+            // BaseVector::dist(). A value close to 0 means that both vectors
+            // are similar
+            return std::abs((1.0-c)/2.0);
+        }
+
+    private:
+        const T* _data;
+        dim_t _dim;
+
+        float _cos(VectorView v) const {
+            float magnitude_a = 0.0;
+            float magnitude_b = 0.0;
+            float dot_product = 0.0;
+
+            for (std::size_t i = 0; i < this->_dim; i++) {
+                float a = this->_data[i];
+                float b = v._data[i];
+                dot_product += a*b;
+                magnitude_a += a*a;
+                magnitude_b += b*b;
+            }
+
+            return dot_product / (std::sqrt(magnitude_a) * std::sqrt(magnitude_b));
+        }
+    };
+
+    template<typename T>
+    class MutableVectorView;
+
+    /**
+     * @brief View of a vector permuted as if by p(times), without moving its
+     * entries.
+     *
+     * Binds, bundles, accumulators and distances read the entries at their
+     * rotated positions, so a permutation that is consumed right away costs
+     * no pass over memory. materialize() writes the permuted vector when it
+     * has to be stored. The entries move towards the higher dimensions, as
+     * with Vector::p().
+     */
+    template<typename T>
+    class RotatedView
+    {
+    public:
+        RotatedView(VectorView<T> base, std::uint64_t times)
+            : _base(base), _offset(base.size() ? times % base.size() : 0) {
+            HDC_COUNT(permute, 0);
+        }
+
+        dim_t size() const { return this->_base.size(); }
+        VectorView<T> base() const { return this->_base; }
+        dim_t offset() const { return this->_offset; }
+
+        T get(std::size_t pos) const {
+            if (pos >= this->size()) {
+                throw std::out_of_range("Vector view index out of range.");
+            }
+            return this->_base.data()[this->_source(pos)];
+        }
+
+        // Call f(i, entry) for the entries of the rotated vector in order
+        template<typename F>
+        void for_each(F f) const {
+            const T* data = this->_base.data();
+            const dim_t dim = this->size();
+            const dim_t r = this->_offset;
+            for (std::size_t i = 0; i < r; i++) {
+                f(i, data[dim - r + i]);
+            }
+            for (std::size_t i = r; i < dim; i++) {
+                f(i, data[i - r]);
+            }
+        }
+
+        float dist(VectorView<T> v) const {
+            _check_dim(this->size(), v.size());
+            HDC_COUNT(distance, 2*this->size());
+            float magnitude_a = 0.0;
+            float magnitude_b = 0.0;
+            float dot_product = 0.0;
+
+            const T* rhs = v.data();
+            this->for_each([&](std::size_t i, float a) {
+                float b = rhs[i];
+                dot_product += a*b;
+                magnitude_a += a*a;
+                magnitude_b += b*b;
+            });
+
+            float c = dot_product / (std::sqrt(magnitude_a) * std::sqrt(magnitude_b));
+            return std::abs((1.0-c)/2.0);
+        }
+
+        void materialize(MutableVectorView<T> out) const {
+            _check_dim(out.size(), this->size());
+            HDC_COUNT(permute, this->size(), 0);
+            const T* data = this->_base.data();
+            const dim_t dim = this->size();
+            std::rotate_copy(data, data + dim - this->_offset, data + dim, out.data());
+        }
+
+    private:
+        VectorView<T> _base;
+        dim_t _offset;
+
+        dim_t _source(dim_t pos) const {
+            return pos >= this->_offset ? pos - this->_offset : pos + this->size() - this->_offset;
+        }
+    };
+
+    /**
+     * @brief Hypervector over memory that it does not own and that the
+     * operations write to. It converts to a VectorView.
+     */
+    template<typename T>
+    class MutableVectorView
+    {
+    public:
+        MutableVectorView(T* data, dim_t dim) : _data(data), _dim(dim) {}
+
+        operator VectorView<T>() const { return VectorView<T>(this->_data, this->_dim); }
+
+        dim_t size() const { return this->_dim; }
+        T* data() const { return this->_data; }
+
+        float dist(VectorView<T> v) const { return VectorView<T>(*this).dist(v); }
+
+        void add(VectorView<T> v1, VectorView<T> v2) const {
+            _check_dim(this->_dim, v1.size());
+            _check_dim(this->_dim, v2.size());
+            HDC_COUNT(bundle, 3*this->_dim);
+            const T* a = v1.data();
+            const T* b = v2.data();
+            for (std::size_t i = 0; i < this->_dim; i++) {
+                this->_data[i] += a[i] + b[i];
+            }
+        }
+
+        // Bundle of Vectors, VectorViews or RotatedViews into this view,
+        // which must not be one of them. Each entry adds the vectors in order.
+        template<typename V>
+        void add(const V* vectors, std::size_t n) const {
+            HDC_COUNT(bundle, n*this->_dim);
+            std::fill(this->_data, this->_data + this->_dim, T(0));
+            for (std::size_t k = 0; k < n; k++) {
+                _check_dim(this->_dim, vectors[k].size());
+                _for_each(vectors[k], [this](std::size_t d, T v) {
+                    this->_data[d] += v;
+                });
+            }
+        }
+
+        void mul(VectorView<T> rhs) const {
+            _check_dim(this->_dim, rhs.size());
+            HDC_COUNT(bind, 2*this->_dim);
+            const T* r = rhs.data();
+            for (std::size_t i = 0; i < this->_dim; i++) {
+                this->_data[i] *= r[i];
+            }
+        }
+
+        void mul(const RotatedView<T>& rhs) const {
+            _check_dim(this->_dim, rhs.size());
+            HDC_COUNT(bind, 2*this->_dim);
+            rhs.for_each([this](std::size_t i, T v) { this->_data[i] *= v; });
+        }
+
+    private:
+        T* _data;
+        dim_t _dim;
+
+        template<typename F>
+        static void _for_each(VectorView<T> v, F f) {
+            const T* data = v.data();
+            for (std::size_t i = 0; i < v.size(); i++) {
+                f(i, data[i]);
+            }
+        }
+
+        template<typename F>
+        static void _for_each(const RotatedView<T>& v, F f) { v.for_each(f); }
+    };
+
+    // Binary vectors are viewed as packed words. Dimensions are rounded up to
+    // whole words, as for Vector.
+    template<>
+    class VectorView<bin_vec_t>
+    {
+    public:
+        VectorView(const bin_vec_t* data, dim_t dim)
+            : _data(data), _dim(_bin_words(dim) * sizeof(bin_vec_t) * 8) {}
+
+        dim_t size() const { return this->_dim; }
+        std::size_t words() const { return _bin_words(this->_dim); }
+        const bin_vec_t* data() const { return this->_data; }
+
+        const bin_vec_t* cbegin() const { return this->_data; }
+        const bin_vec_t* cend() const { return this->_data + this->words(); }
+
+        int get(dim_t pos) const;
+        dim_t hamming(VectorView rhs) const;
+        float dist(VectorView rhs) const;
+
+    private:
+        const bin_vec_t* _data;
+        dim_t _dim;
+    };
+
+    // Binary vectors rotate by whole words and funnel shift the remaining
+    // bits. The bits move towards the lower dimensions, as with
+    // Vector<bin_vec_t>::p().
+    template<>
+    class RotatedView<bin_vec_t>
+    {
+    public:
+        RotatedView(VectorView<bin_vec_t> base, std::uint64_t times)
+            : _base(base), _offset(base.size() ? times % base.size() : 0) {
+            HDC_COUNT(permute, 0);
+        }
+
+        dim_t size() const { return this->_base.size(); }
+        std::size_t words() const { return this->_base.words(); }
+        VectorView<bin_vec_t> base() const { return this->_base; }
+        dim_t offset() const { return this->_offset; }
+
+        int get(dim_t pos) const {
+            if (pos >= this->size()) {
+                throw std::out_of_range("Vector view index out of range.");
+            }
+            return this->_base.get((pos + this->_offset) % this->size());
+        }
+
+        // Word w of the rotated vector
+        bin_vec_t word(std::size_t w) const {
+            constexpr unsigned bits = sizeof(bin_vec_t) * 8;
+            const bin_vec_t* data = this->_base.data();
+            const std::size_t words = this->words();
+            const unsigned s = this->_offset % bits;
+            std::size_t i = w + this->_offset / bits;
+            i -= i >= words ? words : 0;
+            if (!s) {
+                return data[i];
+            }
+            std::size_t j = i + 1 == words ? 0 : i + 1;
+            return (data[i] << s) | (data[j] >> (bits - s));
+        }
+
+        // Call f(w, word) for the words of the rotated vector in order
+        template<typename F>
+        void for_each_word(F f) const {
+            constexpr unsigned bits = sizeof(bin_vec_t) * 8;
+            const bin_vec_t* data = this->_base.data();
+            const std::size_t words = this->words();
+            const std::size_t q = this->_offset / bits;
+            const unsigned s = this->_offset % bits;
+            if (!s) {
+                for (std::size_t w = 0; w < words - q; w++) {
+                    f(w, data[w + q]);
+                }
+                for (std::size_t w = words - q; w < words; w++) {
+                    f(w, data[w + q - words]);
+                }
+                return;
+            }
+
+            // Word w takes the low bits of word w+q and the high bits of the
+            // next one, wrapping around the end of the vector
+            for (std::size_t w = 0; w + q + 1 < words; w++) {
+                f(w, (data[w + q] << s) | (data[w + q + 1] >> (bits - s)));
+            }
+            f(words - q - 1, (data[words - 1] << s) | (data[0] >> (bits - s)));
+            for (std::size_t w = words - q; w < words; w++) {
+                f(w, (data[w + q - words] << s) | (data[w + q - words + 1] >> (bits - s)));
+            }
+        }
+
+        dim_t hamming(VectorView<bin_vec_t> rhs) const;
+        float dist(VectorView<bin_vec_t> rhs) const;
+        void materialize(MutableVectorView<bin_vec_t> out) const;
+
+    private:
+        VectorView<bin_vec_t> _base;
+        dim_t _offset;
+    };
+
+    template<>
+    class MutableVectorView<bin_vec_t>
+    {
+    public:
+        MutableVectorView(bin_vec_t* data, dim_t dim)
+            : _data(data), _dim(_bin_words(dim) * sizeof(bin_vec_t) * 8) {}
+
+        operator VectorView<bin_vec_t>() const {
+            return VectorView<bin_vec_t>(this->_data, this->_dim);
+        }
+
+        dim_t size() const { return this->_dim; }
+        std::size_t words() const { return _bin_words(this->_dim); }
+        bin_vec_t* data() const { return this->_data; }
+
+        dim_t hamming(VectorView<bin_vec_t> rhs) const {
+            return VectorView<bin_vec_t>(*this).hamming(rhs);
+        }
+        float dist(VectorView<bin_vec_t> rhs) const {
+            return VectorView<bin_vec_t>(*this).dist(rhs);
+        }
+
+        // Bit majority of this view and two others
+        void add(VectorView<bin_vec_t> v1, VectorView<bin_vec_t> v2) const;
+
+        // Bit majority of Vectors, VectorViews or RotatedViews into this
+        // view, which must not be one of them. Only defined for those types.
+        template<typename V>
+        void add(const V* vectors, std::size_t n) const;
+
+        void mul(VectorView<bin_vec_t> rhs) const;
+        void mul(const RotatedView<bin_vec_t>& rhs) const;
+
+    private:
+        bin_vec_t* _data;
+        dim_t _dim;
+    };
+}
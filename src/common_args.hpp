@@ -1,8 +1,20 @@
 #pragma once
 
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
 #include <argparse/argparse.hpp>
 
+#include "BindingTable.hpp"
+#include "ContinuousItemMemory.hpp"
+#include "ItemMemory.hpp"
+#include "OpCounters.hpp"
+#include "Profiler.hpp"
 #include "hdc.hpp"
+#include "libbin/bitmanip.hpp"
 
 namespace common_args {
     void add_args(argparse::ArgumentParser& program) {
@@ -16,9 +28,119 @@ namespace common_args {
             .scan<'d', size_t>()
             .default_value<size_t>(0);
 
+        program.add_argument("-t", "--threads")
+            .help("Number of threads. Zero uses all available cores.")
+            .scan<'d', size_t>()
+            .default_value<size_t>(0);
+
+        program.add_argument("--isa")
+            .help("Instruction set of the binary kernels. Values accepted: "
+                  "{auto, scalar, sse4.2, avx2}. auto uses the LIBBIN_ISA "
+                  "environment variable if it is set, or the best set "
+                  "supported by the CPU.")
+            .default_value(std::string("auto"));
+
+        program.add_argument("--seed")
+            .help("Seed of the random number generator used to create the "
+                  "item memories.")
+            .scan<'d', unsigned int>()
+            .default_value<unsigned int>(1);
+
+        program.add_argument("--profile")
+            .help("Report the wall time, throughput and peak memory of each "
+                  "phase to stderr when the program ends. Use --profile=json "
+                  "for a JSON report.")
+            .default_value(std::string(""))
+            .implicit_value(std::string("text"))
+            .nargs(0, 1);
+
         program.add_argument("--hdc").
             help("Choose the HDC type used between supported options. Values "
                  "accepted: {bin, int, float}.")
             .default_value("bin");
     }
+
+    /**
+     * @brief Add the options of the table of ID and level bindings.
+     *
+     * @param items: What the IDs stand for, such as "feature ID" or "channel".
+     */
+    void add_binding_args(argparse::ArgumentParser& program, const std::string& items) {
+        program.add_argument("--binding-table")
+            .help("Precompute the binding of every " + items + " with every "
+                  "level and encode samples by bundling table rows.")
+            .default_value(false)
+            .implicit_value(true);
+        program.add_argument("--binding-budget")
+            .help("Maximum memory in MiB used by the binding table. The table is "
+                  "not built if it does not fit.")
+            .scan<'d', size_t>()
+            .default_value<size_t>(512);
+    }
+
+    // Build the table of ID and level bindings if requested and within budget
+    template<typename VectorType>
+    std::unique_ptr<hdc::BindingTable<VectorType>> make_binding_table(
+            const argparse::ArgumentParser& args,
+            const hdc::ItemMemory<VectorType> &idm,
+            const hdc::ContinuousItemMemory<VectorType> &cim,
+            const std::string& items
+            ) {
+        if (!args.get<bool>("--binding-table")) {
+            return nullptr;
+        }
+
+        std::size_t budget = args.get<size_t>("--binding-budget") << 20;
+        std::size_t footprint = hdc::BindingTable<VectorType>::footprint(
+                idm.size(), cim.size(), idm[0].size());
+        if (footprint > budget) {
+            std::cout << "Binding table needs " << (footprint >> 20) << " MiB and "
+                "exceeds the budget. Binding " << items << "s on the fly." << std::endl;
+            return nullptr;
+        }
+
+        return std::make_unique<hdc::BindingTable<VectorType>>(idm, cim);
+    }
+
+    // Throw std::runtime_error if --profile names an unknown format
+    void check_profile(const argparse::ArgumentParser& args) {
+        auto format = args.get("--profile");
+        if (format != "" && format != "text" && format != "json") {
+            throw std::runtime_error("Unknown profile format: " + format);
+        }
+    }
+
+    /**
+     * @brief Print the profile requested with --profile when the object is
+     * destroyed, at the end of main().
+     */
+    class ProfileReport
+    {
+    public:
+        ProfileReport(const argparse::ArgumentParser& args, const std::string& app)
+            : _format(args.get("--profile")), _app(app) {
+            check_profile(args);
+            // Start measuring the total time
+            hdc::Profiler::global();
+        }
+        ProfileReport(const ProfileReport&)=delete;
+        ProfileReport& operator=(const ProfileReport&)=delete;
+
+        ~ProfileReport() {
+            if (this->_format == "text") {
+                hdc::Profiler::global().report(std::cerr);
+            }
+            else if (this->_format == "json") {
+                hdc::Profiler::global().report_json(std::cerr, this->_app);
+            }
+            else if (hdc::OpCounters::enabled()) {
+                // Builds with operation counters always report them
+                hdc::OpCounters::report(std::cerr);
+            }
+        }
+
+    private:
+        std::string _format;
+        std::string _app;
+    };
 }
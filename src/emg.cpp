@@ -7,93 +7,92 @@
 #include <array>
 #include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cmath>
 #include <cstddef>
-#include <cstring>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <optional>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <argparse/argparse.hpp>
 
+#include "Arena.hpp"
 #include "AssociativeMemory.hpp"
+#include "BindingTable.hpp"
 #include "ContinuousItemMemory.hpp"
+#include "DatasetView.hpp"
+#include "EncodedDataset.hpp"
 #include "ItemMemory.hpp"
+#include "MappedFile.hpp"
+#include "Matrix.hpp"
+#include "Profiler.hpp"
+#include "Quantizer.hpp"
+#include "RecordEncoder.hpp"
+#include "ThreadPool.hpp"
 #include "common.hpp"
 #include "common_args.hpp"
 #include "hdc.hpp"
 
 typedef double data_entry_t;
-typedef std::array<data_entry_t, 4> data_t;
-typedef std::vector<data_t> dataset_t;
+typedef hdc::DatasetView<data_entry_t> dataset_t;
 typedef std::uint8_t label_entry_t;
 typedef std::vector<label_entry_t> label_t;
+typedef hdc::DatasetView<std::uint32_t> quantized_t;
 
 // Number of subjects in the dataset
 const int _SUBJECTS = 5;
 
-enum encode_t {SPATIAL, TEMPORAL};
-static encode_t g_encode;
-
-dataset_t read_dataset(const char* path) {
-    bin_buffer_t buffer = read_bin_file(path);
-    dataset_t dataset;
-
-    // Each entry in the dataset comprise 4 doubles since the EMG
-    // contains 4 channels
-    const std::size_t ENTRY_SIZE = sizeof(double) * 4;
+// Each entry in the dataset comprises one value per EMG channel
+const std::size_t _CHANNELS = 4;
 
-    // Make sure the buffer size is multiple of the entry size
-    assert((buffer.size() % ENTRY_SIZE) == 0);
+// Samples per chunk of work given to the thread pool
+const std::size_t _GRAIN = 64;
 
-    for (std::size_t i = 0; i < buffer.size(); i += ENTRY_SIZE) {
-        data_t entry;
-        std::memcpy(entry.data(), buffer.data()+i, ENTRY_SIZE);
-        dataset.emplace_back(entry);
-    }
+enum encode_t {SPATIAL, TEMPORAL};
 
-    return dataset;
+// Map the dataset file. Entries are read from the mapping, not copied.
+dataset_t read_dataset(const std::string& path) {
+    return dataset_t::open(path, _CHANNELS);
 }
 
-label_t read_labels(const char* path) {
-    bin_buffer_t buffer = read_bin_file(path);
-    label_t labels;
-
-    labels.resize(buffer.size());
-    std::memcpy(labels.data(), buffer.data(), buffer.size());
-
-    return labels;
+label_t read_labels(const std::string& path) {
+    hdc::MappedFile file(path);
+    return label_t(file.data(), file.data() + file.size());
 }
 
 void downsample(
         std::uint32_t downsamp_rate,
-        const dataset_t &d_i,
+        const quantized_t &d_i,
         const label_t &l_i,
-        dataset_t &d_o,
+        quantized_t &d_o,
         label_t &l_o) {
     // Check if the input dataset and label are from the same subject
     assert(d_i.size() == l_i.size());
 
-    d_o.clear();
+    d_o = d_i.stride(downsamp_rate);
     l_o.clear();
 
-    for (std::size_t i = 0; i < d_i.size(); i += downsamp_rate) {
-        d_o.emplace_back(d_i[i]);
+    for (std::size_t i = 0; i < l_i.size(); i += downsamp_rate) {
         l_o.emplace_back(l_i[i]);
     }
 }
 
-void gen_train_data(
-        float training_frac,
-        dataset_t d_i,
-        label_t l_i,
-        dataset_t &d_o,
-        label_t &l_o) {
+// Indexes of the training samples: the first "training_frac" of the samples
+// of every label, from label 1 to 7
+std::vector<std::size_t> train_indexes(float training_frac, const label_t &l_i) {
     // Get the N first indexes labels from 1 to 7
     auto find_indexes = [](
             std::uint8_t val,
             float training_frac,
-            label_t &labels) -> std::vector<std::size_t> {
+            const label_t &labels) -> std::vector<std::size_t> {
         std::vector<std::size_t> ret;
 
         int count = std::count(labels.begin(), labels.end(), val);
@@ -117,189 +116,222 @@ void gen_train_data(
     auto L6 = find_indexes(6, training_frac, l_i);
     auto L7 = find_indexes(7, training_frac, l_i);
 
-    // Create data vector
-    d_o.clear();
-
-    auto append_data = [](
-            const std::vector<std::size_t> &ind_vec,
-            const dataset_t &d_i,
-            dataset_t &d_o) {
-        for (auto i : ind_vec) {
-            d_o.emplace_back(d_i[i]);
-        }
-    };
+    // Select the entries of every label in order
+    std::vector<std::size_t> indexes;
+    for (const auto *L : {&L1, &L2, &L3, &L4, &L5, &L6, &L7}) {
+        indexes.insert(indexes.end(), L->begin(), L->end());
+    }
+    return indexes;
+}
 
-    append_data(L1, d_i, d_o);
-    append_data(L2, d_i, d_o);
-    append_data(L3, d_i, d_o);
-    append_data(L4, d_i, d_o);
-    append_data(L5, d_i, d_o);
-    append_data(L6, d_i, d_o);
-    append_data(L7, d_i, d_o);
+void gen_train_data(
+        float training_frac,
+        const quantized_t &d_i,
+        const label_t &l_i,
+        quantized_t &d_o,
+        label_t &l_o) {
+    // The train data is a view of the input entries
+    auto indexes = train_indexes(training_frac, l_i);
+    d_o = d_i.select(indexes);
 
     // Create labels vector
     l_o.clear();
-    auto append_label = [](const std::vector<std::size_t> &ind_vec,
-            const label_t &l_i,
-            label_t &l_o) {
-        for (auto i : ind_vec) {
-            l_o.emplace_back(l_i[i]);
-        }
-    };
+    for (auto i : indexes) {
+        l_o.emplace_back(l_i[i]);
+    }
+}
 
-    append_label(L1, l_i, l_o);
-    append_label(L2, l_i, l_o);
-    append_label(L3, l_i, l_o);
-    append_label(L4, l_i, l_o);
-    append_label(L5, l_i, l_o);
-    append_label(L6, l_i, l_o);
-    append_label(L7, l_i, l_o);
+// Level of every channel of every entry in a dataset
+quantized_t quantize(const hdc::Quantizer &quantizer, const dataset_t &dataset) {
+    hdc::Matrix<std::uint32_t> quantized(dataset.size(), dataset.cols());
+    if (const data_entry_t *values = dataset.contiguous()) {
+        quantizer.quantize(values, quantized.size(), quantized.data());
+    }
+    else {
+        for (std::size_t i = 0; i < dataset.size(); i++) {
+            quantizer.quantize(dataset[i], dataset.cols(), quantized.row(i));
+        }
+    }
+    return quantized_t::own(std::move(quantized));
 }
 
-int get_amplitude_bin(float amp, int levels) {
-    // Dataset values vary between 0.0 and 20.0
-    const float min =  0.0;
-    const float max = 20.0;
-    const float epsilon = 0.2;
+/**
+ * Spatial vectors of the samples of a dataset. When the n-grams of adjacent
+ * windows share samples, every sample is encoded once into a contiguous cache
+ * and the n-grams are composed from the cached rows. Single samples are only
+ * used once and are encoded when requested.
+ */
+template<typename VectorType>
+class SpatialEncoder
+{
+public:
+    SpatialEncoder(
+            int N_grams,
+            const quantized_t &dataset,
+            const hdc::ItemMemory<VectorType> &idm,
+            const hdc::ContinuousItemMemory<VectorType> &cim,
+            const hdc::BindingTable<VectorType> *table
+            ) : _dataset(dataset), _idm(idm), _cim(cim), _table(table) {
+        if (N_grams > 1) {
+            this->_cache.emplace(dataset.size(), idm[0].size(), [&](std::size_t i) {
+                return this->_encode(i);
+            }, _GRAIN);
+        }
+    }
 
-    // Some entries in the dataset are slightly higher than the 20.0 value
-    // specified in the paper. Adjust their values to 20.0
-    amp = amp > max ? max : amp;
+    std::size_t size() const { return this->_dataset.size(); }
+    hdc::dim_t dim() const { return this->_idm[0].size(); }
 
-    float range = max-min;
-    float step = range / levels;
+    VectorType at(std::size_t entry, const typename VectorType::allocator_type &alloc={}) const {
+        if (this->_cache) {
+            return this->_cache->at(entry, alloc);
+        }
+        if (entry >= this->_dataset.size()) {
+            throw std::out_of_range("Spatial encoder index out of range.");
+        }
+        return this->_encode(entry, alloc);
+    }
 
-    for (int i = 0; i < levels; i++) {
-        float top_threshold = min+(step*(i+1));
-        if (amp <= top_threshold) {
-            return i;
+    // View of a cached sample. Samples are only cached for n-grams.
+    typename VectorType::view_type view(std::size_t entry) const {
+        if (!this->_cache) {
+            throw std::runtime_error("Spatial vectors are only cached for n-grams.");
         }
+        return this->_cache->view(entry);
     }
 
-    std::cerr << "Unreachable condition in get_amplitude_bin(). Value: " <<
-        amp << std::endl;
-    assert(false);
-    return -1;
-}
+private:
+    quantized_t _dataset;
+    const hdc::ItemMemory<VectorType> &_idm;
+    const hdc::ContinuousItemMemory<VectorType> &_cim;
+    const hdc::BindingTable<VectorType> *_table;
+    std::optional<hdc::EncodedDataset<VectorType>> _cache;
+
+    VectorType _encode(std::size_t entry, const typename VectorType::allocator_type &alloc={}) const {
+        const std::uint32_t *channels = this->_dataset[entry];
+        VectorType res(this->dim(), false, alloc);
+        if (this->_table) {
+            this->_table->encode_into(res, channels, this->_dataset.cols());
+        }
+        else {
+            hdc::encode_record_into(res, this->_idm, this->_cim, channels, this->_dataset.cols());
+        }
+        return res;
+    }
+};
 
 template<typename VectorType>
 VectorType encode_query(
-        int levels,
         int N_grams,
+        encode_t encode,
         std::size_t entry,
-        const dataset_t &dataset,
-        const hdc::ItemMemory<VectorType> &idm,
-        const hdc::ContinuousItemMemory<VectorType> &cim
+        const SpatialEncoder<VectorType> &spatial
         ) {
-    std::vector<VectorType> spatial;
-    std::vector<VectorType> temporal;
-
-    for (int i = 0; i < N_grams; i++) {
-        const data_t &channels = dataset.at(entry+i);
-
-        for (std::size_t c = 0; c < channels.size(); c++) {
-            auto &amp = channels[c];
-            int amp_bin = get_amplitude_bin(amp, levels);
-            spatial.emplace_back(hdc::mul(idm.at(c), cim.at(amp_bin)));
-        }
+    if (encode == SPATIAL && N_grams == 1) {
+        return spatial.at(entry);
+    }
 
-        if (g_encode == TEMPORAL) {
-            auto t = hdc::add(spatial);
-            t.p(i);
-            temporal.emplace_back(t);
+    // The samples of n-grams are read from the cache of the encoder
+    if (encode == SPATIAL) {
+        hdc::ScopedArena arena;
+        std::pmr::vector<typename VectorType::view_type> samples(arena.resource());
+        samples.reserve(N_grams);
+        for (int i = 0; i < N_grams; i++) {
+            samples.emplace_back(spatial.view(entry+i));
         }
+        return hdc::add(samples);
     }
 
-    if (g_encode == SPATIAL) {
-        return hdc::add(spatial);
-    }
-    else {
-        return hdc::mul(temporal);
+    // Bind the samples of the n-gram, each permuted by its position. The
+    // permutations are read while binding instead of being stored.
+    VectorType res = spatial.at(entry);
+    for (int i = 1; i < N_grams; i++) {
+        res.mul(hdc::p_view(spatial.view(entry+i), i));
     }
+    return res;
 }
 
 template<typename VectorType>
 float predict(
-        int levels,
         int N_grams,
-        const dataset_t &test_data,
+        encode_t encode,
+        const SpatialEncoder<VectorType> &test_data,
         const label_t &labels,
-        const hdc::ItemMemory<VectorType> &idm,
-        const hdc::ContinuousItemMemory<VectorType> &cim,
         const hdc::AssociativeMemory<VectorType> &am) {
     assert(labels.size() == test_data.size());
 
-    std::size_t correct = 0;
-
-    for (std::size_t i = 0; i+N_grams-1 < test_data.size(); i++) {
-        auto query = encode_query(levels, N_grams, i, test_data, idm, cim);
-        int pred_label = am.search(query);
-        // Adjust the predicted label value since the labels dataset use values
-        // between 1 <-> 5
-        pred_label++;
-        if (pred_label == labels[i]) {
-            correct++;
-        }
-    }
+    std::size_t windows = test_data.size() >= std::size_t(N_grams) ? test_data.size()-N_grams+1 : 0;
+    std::size_t correct = hdc::ThreadPool::global().parallel_reduce(
+            0, windows, _GRAIN, std::size_t(0),
+            [&](std::size_t &correct, std::size_t i) {
+                auto query = encode_query(N_grams, encode, i, test_data);
+                int pred_label = am.search(query);
+                // Adjust the predicted label value since the labels dataset use
+                // values between 1 <-> 5
+                pred_label++;
+                if (pred_label == labels[i]) {
+                    correct++;
+                }
+            },
+            [](std::size_t &res, std::size_t partial) { res += partial; });
 
     return (float)correct/(float)test_data.size()*100.;
 }
 
 template<typename VectorType>
 hdc::AssociativeMemory<VectorType> train_am(
-        int levels,
         int N,
-        const dataset_t &train_dataset,
+        encode_t encode,
+        const SpatialEncoder<VectorType> &train_dataset,
         const label_t &train_labels,
-        const dataset_t &test_dataset,
-        const label_t &test_labels,
-        const hdc::ItemMemory<VectorType> &idm,
-        const hdc::ContinuousItemMemory<VectorType> &cim
+        const SpatialEncoder<VectorType> &test_dataset,
+        const label_t &test_labels
         ) {
     hdc::AssociativeMemory<VectorType> am;
-    std::vector<VectorType> encoded;
-
-    int min = *std::min_element(train_labels.begin(), train_labels.end());
-    label_entry_t label = min;
-
-    for (std::size_t i = 0; i+N-1 < train_labels.size(); i++) {
-        if (label != train_labels[i]) {
-            am.emplace_back(hdc::add(encoded));
-            encoded.clear();
-            label = train_labels[i];
+    auto &pool = hdc::ThreadPool::global();
+
+    // Each run of equal labels becomes a class vector. Only windows whose
+    // N samples share the same label are encoded.
+    std::size_t windows = train_labels.size() >= std::size_t(N) ? train_labels.size()-N+1 : 0;
+    std::size_t start = 0;
+    while (start < windows) {
+        std::size_t stop = start;
+        std::vector<std::size_t> entries;
+        for (; stop < windows && train_labels[stop] == train_labels[start]; stop++) {
+            if (train_labels[stop] == train_labels[stop+N-1]) {
+                entries.emplace_back(stop);
+            }
         }
 
-        if (train_labels[i] == train_labels[i+N-1]) {
-            auto enc = encode_query(levels, N, i, train_dataset, idm, cim);
-            encoded.emplace_back(enc);
-        }
-    }
+        // Encode the windows of the run in parallel
+        std::vector<VectorType> encoded(entries.size(), VectorType(train_dataset.dim(), false));
+        pool.parallel_for(0, entries.size(), [&](std::size_t k) {
+            encoded[k] = encode_query(N, encode, entries[k], train_dataset);
+        }, _GRAIN);
 
-    // Append last value
-    am.emplace_back(hdc::add(encoded));
+        am.emplace_back(hdc::add(encoded));
+        start = stop;
+    }
 
     return am;
 }
 
 template<typename VectorType>
 int predict_window_max(
-        int levels,
         int N_grams,
+        encode_t encode,
         std::size_t start,
         std::size_t stop,
-        const dataset_t &dataset,
+        const SpatialEncoder<VectorType> &dataset,
         const label_t &labels,
-        const hdc::ItemMemory<VectorType> &idm,
-        const hdc::ContinuousItemMemory<VectorType> &cim,
         const hdc::AssociativeMemory<VectorType> &am) {
-    std::vector<VectorType> encoded;
+    std::vector<VectorType> encoded(stop-start, VectorType(dataset.dim(), false));
 
     // Given a start and an end, predict which is the most probable class in the
     // window
-    for (int i = start; i < stop; i++) {
-        auto enc = encode_query(levels, N_grams, i, dataset, idm, cim);
-        encoded.emplace_back(enc);
-    }
+    hdc::ThreadPool::global().parallel_for(start, stop, [&](std::size_t i) {
+        encoded[i-start] = encode_query(N_grams, encode, i, dataset);
+    }, _GRAIN);
 
     // Search for the vector with highest similarity
     int index = 0;
@@ -320,12 +352,10 @@ int predict_window_max(
 
 template<typename VectorType>
 float test_slicing(
-        int levels,
         int N_grams,
-        const dataset_t &dataset,
+        encode_t encode,
+        const SpatialEncoder<VectorType> &dataset,
         const label_t &labels,
-        const hdc::ItemMemory<VectorType> &idm,
-        const hdc::ContinuousItemMemory<VectorType> &cim,
         const hdc::AssociativeMemory<VectorType> &am) {
     // This function is a simplified version of the same function
     // available in Rahimi's matlab script since it does not consider
@@ -348,16 +378,16 @@ float test_slicing(
             stop = i;
             window = stop - start;
             window = std::max(window, N_grams);
+            // The windows of the last slice must not run past the dataset
+            window = std::min<int>(window, labels.size() - N_grams + 1 - start);
 
             int pred_label = predict_window_max(
-                    levels,
                     N_grams,
+                    encode,
                     start,
                     start+window,
                     dataset,
                     labels,
-                    idm,
-                    cim,
                     am);
 
             // Adjust the 0-indexed pred_label to compare it with the
@@ -370,188 +400,343 @@ float test_slicing(
             }
             start = labels.size();
         }
-        else {
-            // Unreachable condition
-            throw std::runtime_error("Unreachable condition in test_slicing()");
-        }
+        // Otherwise the sample is inside a slice or is a slice of a single
+        // sample, which is not tested
     }
 
     return (float)correct/(float)predictions * 100.;
 }
 
-// Main //
+/**
+ * Online classification of a stream of EMG samples. The spatial vectors of the
+ * last N_grams samples are kept in a ring buffer, so every sample is encoded
+ * once when it arrives. The temporal n-gram is composed from the buffered
+ * vectors in the same order as encode_query(). All vectors are allocated by
+ * the constructor and reused for every sample.
+ */
 template<typename VectorType>
-int emg(const argparse::ArgumentParser &args) {
-    std::string dataset_dir = args.get<std::string>("dataset");
-    const int CHANNELS = 4;
+class StreamClassifier
+{
+public:
+    StreamClassifier(
+            int N_grams,
+            const hdc::Quantizer &quantizer,
+            const hdc::ItemMemory<VectorType> &idm,
+            const hdc::ContinuousItemMemory<VectorType> &cim,
+            const hdc::BindingTable<VectorType> *table,
+            const hdc::AssociativeMemory<VectorType> &am
+            ) : _quantizer(quantizer), _idm(idm), _cim(cim), _table(table), _am(am),
+                _spatial(N_grams, VectorType(idm[0].size(), false)),
+                _query(idm[0].size(), false),
+                _levels(_CHANNELS) {}
+
+    // Encode the newest sample, which replaces the oldest one in the window
+    void push(const data_entry_t *sample) {
+        this->_quantizer.quantize(sample, _CHANNELS, this->_levels.data());
+
+        VectorType &slot = this->_spatial[this->_next];
+        if (this->_table) {
+            this->_table->encode_into(slot, this->_levels.data(), _CHANNELS);
+        }
+        else {
+            hdc::encode_record_into(slot, this->_idm, this->_cim, this->_levels.data(), _CHANNELS);
+        }
 
-    hdc::dim_t dim = args.get<size_t>("--dim");
-    size_t levels = args.get<size_t>("--levels");
-    g_encode = SPATIAL;
-    int N_grams = 4;
-    float training_frac = 0.25;
-    std::uint32_t downsample_rate = 1;
-    std::string enc_str;
-
-    //if (g_encode == SPATIAL) {
-    //    enc_str = "SPATIAL";
-    //    N_grams = 1;
-    //}
-    //else {
-    //    enc_str = "TEMPORAL";
-    //}
-
-    //std::cerr << "D: " << dim <<
-    //    " Levels: " << levels <<
-    //    " Encode type: " << enc_str <<
-    //    " N-grams: " << N_grams <<
-    //    " Training Fraction: " << training_frac * 100.0 << "%" <<
-    //    " Downsample: " << downsample_rate << std::endl;
-
-    hdc::ItemMemory<VectorType> idm(CHANNELS, dim);
-    hdc::ContinuousItemMemory<VectorType> cim(levels, dim);
+        this->_next = (this->_next + 1) % this->_spatial.size();
+        this->_count = std::min(this->_count + 1, this->_spatial.size());
+    }
+
+    // Whether enough samples arrived to fill a window
+    bool ready() const { return this->_count == this->_spatial.size(); }
+
+    // Label of the window of the last N_grams samples
+    label_entry_t classify() {
+        const std::size_t N = this->_spatial.size();
+        if (N == 1) {
+            return this->_am.search(this->_spatial[0]) + 1;
+        }
+
+        // The oldest sample is in the slot that the next sample overwrites
+        this->_query = this->_spatial[this->_next];
+        for (std::size_t i = 1; i < N; i++) {
+            this->_query.mul(hdc::p_view(this->_spatial[(this->_next + i) % N], i));
+        }
 
-    // Dataset variables
-    std::vector<dataset_t> complete;
-    std::vector<label_t> labels;
-    std::array<dataset_t, _SUBJECTS> ts_complete;
-    std::array<label_t, _SUBJECTS> ts_labels;
-    std::array<dataset_t, _SUBJECTS> train_complete;
-    std::array<label_t, _SUBJECTS> train_labels;
-
-    //-- Experiments --//
-
-    // Spatial encoding experiment
-    // Train and predict spatial encoding
-    std::cout << "Spatial encoding" << std::endl;
-    if (g_encode == SPATIAL) {
-        enc_str = "SPATIAL";
-        N_grams = 1;
+        // AM entries are 0-indexed and the labels start at 1
+        return this->_am.search(this->_query) + 1;
     }
-    else {
-        enc_str = "TEMPORAL";
+
+private:
+    const hdc::Quantizer &_quantizer;
+    const hdc::ItemMemory<VectorType> &_idm;
+    const hdc::ContinuousItemMemory<VectorType> &_cim;
+    const hdc::BindingTable<VectorType> *_table;
+    const hdc::AssociativeMemory<VectorType> &_am;
+
+    std::vector<VectorType> _spatial;
+    std::size_t _next = 0;
+    std::size_t _count = 0;
+    VectorType _query;
+    std::vector<std::uint32_t> _levels;
+};
+
+// Nearest-rank percentile of sorted values
+double percentile(const std::vector<double> &sorted, double q) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    std::size_t rank = std::ceil(q * sorted.size());
+    return sorted[std::max<std::size_t>(rank, 1) - 1];
+}
+
+/**
+ * Feed the samples of every subject to a StreamClassifier as if they came
+ * from the sensor at "rate" samples per second, or as fast as possible if the
+ * rate is zero. The latency of a sample is the time from its arrival to its
+ * prediction. Samples that arrive while the previous one is still being
+ * classified wait in the sensor and that wait counts as latency.
+ */
+template<typename VectorType>
+int replay(
+        const argparse::ArgumentParser &args,
+        const std::string &dataset_dir,
+        const hdc::Quantizer &quantizer,
+        const hdc::ItemMemory<VectorType> &idm,
+        const hdc::ContinuousItemMemory<VectorType> &cim,
+        const hdc::BindingTable<VectorType> *table
+        ) {
+    using clock = std::chrono::steady_clock;
+    using micros = std::chrono::duration<double, std::micro>;
+
+    int N_grams = args.get<int>("--replay-ngrams");
+    double rate = args.get<double>("--replay-rate");
+    float training_frac = 0.25;
+    if (N_grams < 1) {
+        throw std::runtime_error("--replay-ngrams must be at least 1.");
     }
+    encode_t encode = N_grams == 1 ? SPATIAL : TEMPORAL;
 
-    std::cout << "D: " << dim <<
-        " Levels: " << levels <<
-        " Encode type: " << enc_str <<
+    std::cout << "Replay" << std::endl;
+    std::cout << "D: " << args.get<size_t>("--dim") <<
+        " Levels: " << cim.size() <<
         " N-grams: " << N_grams <<
         " Training Fraction: " << training_frac * 100.0 << "%" <<
-        " Downsample: " << downsample_rate << std::endl;
+        " Rate: " << rate << " Hz" << std::endl;
 
     for (int i = 1; i <= _SUBJECTS; i++) {
-        // Read datasets
         std::string num_str = std::to_string(i);
-        std::string d_path = dataset_dir+"/complete"+num_str+".bin";
-        std::string l_path = dataset_dir+"/labels"+num_str+".bin";
-        complete.emplace_back(read_dataset(d_path.c_str()));
-        labels.emplace_back(read_labels(l_path.c_str()));
-    }
+        dataset_t samples = read_dataset(dataset_dir+"/complete"+num_str+".bin");
+        label_t labels = read_labels(dataset_dir+"/labels"+num_str+".bin");
+
+        // Train offline with the same encoding used by the stream
+        hdc::ScopedTimer train_timer("train");
+        quantized_t train;
+        label_t train_labels;
+        gen_train_data(training_frac, quantize(quantizer, samples), labels,
+                       train, train_labels);
+        SpatialEncoder<VectorType> train_spatial(N_grams, train, idm, cim, table);
+        auto am = train_am(N_grams, encode, train_spatial, train_labels,
+                           train_spatial, train_labels);
+        train_timer.samples(train.size());
+        train_timer.stop();
+
+        // Only windows without training samples count for the accuracy
+        std::vector<bool> trained(samples.size(), false);
+        for (auto idx : train_indexes(training_frac, labels)) {
+            trained[idx] = true;
+        }
 
-    // Generate testsets. A testset is a downsampled version of the dataset.
-    for (int i = 0; i < complete.size(); i++) {
-        downsample(
-                downsample_rate,
-                complete[i],
-                labels[i],
-                ts_complete[i],
-                ts_labels[i]);
+        StreamClassifier<VectorType> stream(N_grams, quantizer, idm, cim, table, am);
+        std::vector<double> latencies;
+        latencies.reserve(samples.size());
+        std::size_t correct = 0;
+        std::size_t tested = 0;
+        std::size_t missed = 0;
+        // Samples since the last training sample, up to the current one
+        std::size_t untrained = 0;
+        const double period = rate > 0 ? 1e6 / rate : 0.0;
+
+        hdc::ScopedTimer replay_timer("replay");
+        const auto start = clock::now();
+        for (std::size_t k = 0; k < samples.size(); k++) {
+            auto due = start + std::chrono::duration_cast<clock::duration>(micros(k * period));
+            auto arrival = clock::now();
+            if (arrival < due) {
+                std::this_thread::sleep_until(due);
+                arrival = clock::now();
+            }
+            else if (rate > 0) {
+                arrival = due;
+            }
 
-        // Generate train data. The train data is only a fraction
-        // (training_frac) of the test set.
-        gen_train_data(
-                training_frac,
-                ts_complete[i],
-                ts_labels[i],
-                train_complete[i],
-                train_labels[i]);
-
-        float accuracy;
-
-        auto am = train_am(
-                levels,
-                N_grams,
-                train_complete[i],
-                train_labels[i],
-                ts_complete[i],
-                ts_labels[i],
-                idm,
-                cim);
+            stream.push(samples[k]);
+            untrained = trained[k] ? 0 : untrained + 1;
+            if (!stream.ready()) {
+                continue;
+            }
+            label_entry_t pred = stream.classify();
+            double latency = micros(clock::now() - arrival).count();
+
+            latencies.emplace_back(latency);
+            missed += rate > 0 && latency > period;
+            // A window is labeled by its oldest sample, as in predict()
+            if (untrained >= std::size_t(N_grams)) {
+                tested++;
+                correct += pred == labels[k + 1 - N_grams];
+            }
+        }
 
-        accuracy = predict(
-                levels,
-                N_grams,
-                ts_complete[i],
-                ts_labels[i],
-                idm,
-                cim,
-                am);
+        replay_timer.samples(samples.size());
+        replay_timer.encodes(samples.size());
+        replay_timer.searches(latencies.size());
+        replay_timer.stop();
+
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << "Replay[" << num_str << "]: predictions: " << latencies.size()
+            << " accuracy on untrained windows: "
+            << (tested ? (float)correct/(float)tested*100. : 0.) << "%"
+            << " latency p50: " << percentile(latencies, 0.50) << " us"
+            << " p99: " << percentile(latencies, 0.99) << " us"
+            << " max: " << percentile(latencies, 1.0) << " us"
+            << " missed: " << missed << std::endl;
+    }
+
+    return 0;
+}
 
-        std::cout << "Accuracy[" << std::to_string(i) << "]: "
-            << accuracy << "%" << std::endl;
+// Configuration of one of the experiments of the paper
+struct experiment_t {
+    const char *title;
+    encode_t encode;
+    int N_grams;
+    // Downsample rate used for the testset of each subject
+    std::array<std::uint32_t, _SUBJECTS> downsample_rate;
+};
+
+const experiment_t _EXPERIMENTS[] = {
+    {"Spatial encoding", SPATIAL, 1, {1, 1, 1, 1, 1}},
+    {"Temporal encoding", TEMPORAL, 4, {250, 250, 250, 250, 50}},
+};
+
+// Train and test one subject with the configuration of an experiment
+template<typename VectorType>
+float run_subject(
+        const experiment_t &experiment,
+        std::uint32_t downsample_rate,
+        float training_frac,
+        const quantized_t &complete,
+        const label_t &labels,
+        const hdc::ItemMemory<VectorType> &idm,
+        const hdc::ContinuousItemMemory<VectorType> &cim,
+        const hdc::BindingTable<VectorType> *table
+        ) {
+    const int N_grams = experiment.N_grams;
+    const encode_t encode = experiment.encode;
+
+    // Generate the testset. A testset is a downsampled version of the
+    // dataset.
+    quantized_t ts_complete;
+    label_t ts_labels;
+    downsample(downsample_rate, complete, labels, ts_complete, ts_labels);
+
+    // Generate train data. The train data is only a fraction
+    // (training_frac) of the test set.
+    quantized_t train_complete;
+    label_t train_labels;
+    gen_train_data(training_frac, ts_complete, ts_labels, train_complete, train_labels);
+
+    SpatialEncoder<VectorType> train_spatial(N_grams, train_complete, idm, cim, table);
+    SpatialEncoder<VectorType> ts_spatial(N_grams, ts_complete, idm, cim, table);
+
+    auto am = train_am(
+            N_grams,
+            encode,
+            train_spatial,
+            train_labels,
+            ts_spatial,
+            ts_labels);
+
+    if (encode == SPATIAL) {
+        return predict(N_grams, encode, ts_spatial, ts_labels, am);
     }
+    return test_slicing(N_grams, encode, ts_spatial, ts_labels, am);
+}
 
-    // Temporal encoding experiment
-    downsample_rate = 250;
-    N_grams = 4;
-    g_encode = TEMPORAL;
+// Main //
+template<typename VectorType>
+int emg(const argparse::ArgumentParser &args) {
+    std::string dataset_dir = args.get<std::string>("dataset");
 
-    std::cout << "Temporal encoding" << std::endl;
-    if (g_encode == SPATIAL) {
-        enc_str = "SPATIAL";
-        N_grams = 1;
+    hdc::dim_t dim = args.get<size_t>("--dim");
+    size_t levels = args.get<size_t>("--levels");
+    float training_frac = 0.25;
+
+    hdc::ScopedTimer memories_timer("memories");
+    hdc::ItemMemory<VectorType> idm(_CHANNELS, dim);
+    hdc::ContinuousItemMemory<VectorType> cim(levels, dim);
+    auto table = common_args::make_binding_table(args, idm, cim, "channel");
+    memories_timer.stop();
+    // Dataset values vary between 0.0 and 20.0. Some entries are slightly
+    // higher than the 20.0 specified in the paper and fall in the last level.
+    hdc::Quantizer quantizer(0.0, 20.0, levels);
+
+    if (args.get<bool>("--replay")) {
+        return replay(args, dataset_dir, quantizer, idm, cim, table.get());
     }
-    else {
-        enc_str = "TEMPORAL";
+
+    auto &pool = hdc::ThreadPool::global();
+
+    // Read datasets. The channels of every subject are quantized once and the
+    // mapping is released afterwards. Test and train sets are views of the
+    // quantized subjects.
+    hdc::ScopedTimer read_timer("read");
+    std::array<quantized_t, _SUBJECTS> complete;
+    std::array<label_t, _SUBJECTS> labels;
+    pool.parallel_for(0, _SUBJECTS, [&](std::size_t i) {
+        std::string num_str = std::to_string(i+1);
+        complete[i] = quantize(quantizer, read_dataset(dataset_dir+"/complete"+num_str+".bin"));
+        labels[i] = read_labels(dataset_dir+"/labels"+num_str+".bin");
+    });
+    for (const auto &subject : complete) {
+        read_timer.samples(subject.size());
     }
-    std::cout << "D: " << dim <<
-        " Levels: " << levels <<
-        " Encode type: " << enc_str <<
-        " N-grams: " << N_grams <<
-        " Training Fraction: " << training_frac * 100.0 << "%" <<
-        " Downsample: " << downsample_rate << std::endl;
-    for (int i = 0; i < _SUBJECTS; i++) {
-        if (i == _SUBJECTS-1) {
-            downsample_rate = 50;
-        }
-        // Generate new test and train sets
-        downsample(
-                downsample_rate,
+    read_timer.stop();
+
+    // Every subject of every experiment is an independent job. The item
+    // memories and the datasets are only read by the jobs, and each job
+    // writes its own result, which is printed in order once all jobs end.
+    const std::size_t EXPERIMENTS = std::size(_EXPERIMENTS);
+    std::vector<float> accuracy(EXPERIMENTS * _SUBJECTS);
+    hdc::ScopedTimer experiments_timer("experiments");
+    pool.parallel_for(0, accuracy.size(), [&](std::size_t job) {
+        const experiment_t &experiment = _EXPERIMENTS[job / _SUBJECTS];
+        std::size_t i = job % _SUBJECTS;
+        accuracy[job] = run_subject(
+                experiment,
+                experiment.downsample_rate[i],
+                training_frac,
                 complete[i],
                 labels[i],
-                ts_complete[i],
-                ts_labels[i]);
-
-        gen_train_data(
-                training_frac,
-                ts_complete[i],
-                ts_labels[i],
-                train_complete[i],
-                train_labels[i]);
-
-        float accuracy;
-
-        auto am = train_am(
-                levels,
-                N_grams,
-                train_complete[i],
-                train_labels[i],
-                ts_complete[i],
-                ts_labels[i],
-                idm,
-                cim);
-
-        accuracy = test_slicing(
-                levels,
-                N_grams,
-                ts_complete[i],
-                ts_labels[i],
                 idm,
                 cim,
-                am);
-
-        std::cout << "Accuracy[" << std::to_string(i) << "]: "
-            << accuracy << "%" << std::endl;
+                table.get());
+    });
+    experiments_timer.stop();
+
+    for (std::size_t e = 0; e < EXPERIMENTS; e++) {
+        const experiment_t &experiment = _EXPERIMENTS[e];
+        std::cout << experiment.title << std::endl;
+        std::cout << "D: " << dim <<
+            " Levels: " << levels <<
+            " Encode type: " << (experiment.encode == SPATIAL ? "SPATIAL" : "TEMPORAL") <<
+            " N-grams: " << experiment.N_grams <<
+            " Training Fraction: " << training_frac * 100.0 << "%" <<
+            " Downsample: " << experiment.downsample_rate[0] << std::endl;
+
+        for (int i = 0; i < _SUBJECTS; i++) {
+            std::cout << "Accuracy[" << std::to_string(i) << "]: "
+                << accuracy[e * _SUBJECTS + i] << "%" << std::endl;
+        }
     }
 
     return 0;
@@ -568,6 +753,25 @@ auto add_args(argparse::ArgumentParser& program) {
         .scan<'d', size_t>()
         .default_value<size_t>(10);
 
+    common_args::add_binding_args(program, "channel");
+
+    program.add_argument("--replay")
+        .help("Classify every sample online, as it arrives from the sensor, "
+              "instead of running the offline experiments. Reports the "
+              "prediction latency.")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--replay-rate")
+        .help("Samples per second fed to the online classifier. Zero feeds "
+              "them as fast as possible.")
+        .scan<'g', double>()
+        .default_value<double>(500.0);
+    program.add_argument("--replay-ngrams")
+        .help("Number of samples in the temporal n-gram of the online "
+              "classifier. One uses spatial encoding.")
+        .scan<'d', int>()
+        .default_value<int>(4);
+
     return program;
 }
 
@@ -578,12 +782,18 @@ int main(int argc, char *argv[]) {
     try {
         add_args(args);
         args.parse_args(argc, argv);
+        bitmanip::set_isa(args.get("--isa"));
+        common_args::check_profile(args);
     } catch (const std::runtime_error& e) {
         std::cout << args << std::endl;
         std::cerr << "Failed to parse arguments! " << e.what() << std::endl;
         return -1;
     }
 
+    hdc::ThreadPool::set_threads(args.get<size_t>("--threads"));
+    std::srand(args.get<unsigned int>("--seed"));
+    common_args::ProfileReport profile(args, "emg");
+
     auto hdc = args.get("hdc");
 
     if (hdc == "bin") {
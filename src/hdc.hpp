@@ -1,14 +1,18 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <ostream>
+#include <stdexcept>
 #include <vector>
 
 #include "types.hpp"
+#include "Accumulator.hpp"
 #include "AssociativeMemory.hpp"
 #include "ContinuousItemMemory.hpp"
 #include "ItemMemory.hpp"
 #include "Vector.hpp"
+#include "VectorView.hpp"
 
 namespace hdc {
     // Vector data types
@@ -29,11 +33,56 @@ namespace hdc {
         return res;
     }
 
-    template<typename T>
-    T add(const std::vector<T>& vectors) {
+    // The lists of vectors may use any allocator, e.g. std::pmr::vector
+    template<typename T, typename Alloc>
+    T add(const std::vector<T, Alloc>& vectors) {
         return T::add(vectors);
     }
 
+    // Views are bundled into a new vector
+    template<typename T, typename Alloc>
+    Vector<T> add(const std::vector<VectorView<T>, Alloc>& views) {
+        return Vector<T>::add(views);
+    }
+
+    template<typename T, typename Alloc>
+    Vector<T> add(const std::vector<RotatedView<T>, Alloc>& views) {
+        return Vector<T>::add(views);
+    }
+
+    // Weighted bundle. Each vector counts as if it appeared "weight" times in
+    // the bundled list.
+    template<typename T>
+    T add(
+            const std::vector<T>& vectors,
+            const std::vector<typename Accumulator<T>::weight_t>& weights
+            ) {
+        if (vectors.size() != weights.size()) {
+            throw std::runtime_error("Attempt to bundle vectors with a "
+                                     "different number of weights.");
+        }
+
+        Accumulator<T> acc(vectors[0].size());
+        for (std::size_t i = 0; i < vectors.size(); i++) {
+            acc.add(vectors[i], weights[i]);
+        }
+        return acc.result();
+    }
+
+    // Bundle of "vectors" with "subtracted" taken away. It is the bundle of
+    // the list with the inverse of each subtracted vector appended.
+    template<typename T>
+    T subtract(const std::vector<T>& vectors, const std::vector<T>& subtracted) {
+        Accumulator<T> acc(vectors[0].size());
+        for (const auto& v : vectors) {
+            acc.add(v);
+        }
+        for (const auto& v : subtracted) {
+            acc.subtract(v);
+        }
+        return acc.result();
+    }
+
     template<typename T>
     T mul(const T& v1, const T& v2) {
         T res(v1);
@@ -42,7 +91,14 @@ namespace hdc {
     }
 
     template<typename T>
-    T mul(const std::vector<T>& vectors) {
+    Vector<T> mul(VectorView<T> v1, VectorView<T> v2) {
+        Vector<T> res(v1);
+        res.mul(v2);
+        return res;
+    }
+
+    template<typename T, typename Alloc>
+    T mul(const std::vector<T, Alloc>& vectors) {
         T res(vectors[0]);
         for (auto i = 1; i < vectors.size(); i++) {
             res.mul(vectors[i]);
@@ -50,11 +106,70 @@ namespace hdc {
         return res;
     }
 
+    // The permuted vector is written in a single pass over v1
     template<typename T>
     T p(const T& v1, std::uint32_t times=1) {
-        T res(v1);
-        res.p(times);
+        T res(v1.size(), false);
+        typename T::rotated_type(v1, times).materialize(res);
         return res;
     }
+
+    // View of v1 permuted as if by p(), see RotatedView
+    template<typename T>
+    RotatedView<T> p_view(const Vector<T>& v1, std::uint32_t times=1) {
+        return RotatedView<T>(v1, times);
+    }
+
+    template<typename T>
+    RotatedView<T> p_view(VectorView<T> v1, std::uint32_t times=1) {
+        return RotatedView<T>(v1, times);
+    }
+
+    // The *_into() variants write the result into "out" and reuse its
+    // storage, so they do not allocate once "out" has the dimension of the
+    // operands. "out" may be the first operand.
+    template<typename T>
+    void add_into(T& out, const T& v1, const T& v2, const T& v3) {
+        if (&out != &v1) {
+            out = v1;
+        }
+        out.add(v2, v3);
+    }
+
+    // "out" must not be one of the bundled vectors, which may be views
+    template<typename T, typename V, typename Alloc>
+    void add_into(T& out, const std::vector<V, Alloc>& vectors) {
+        T::add_into(out, vectors);
+    }
+
+    template<typename T, typename V, typename Alloc>
+    void add_into(MutableVectorView<T> out, const std::vector<V, Alloc>& vectors) {
+        Vector<T>::add_into(out, vectors);
+    }
+
+    template<typename T>
+    void mul_into(T& out, const T& v1, const T& v2) {
+        if (&out != &v1) {
+            out = v1;
+        }
+        out.mul(v2);
+    }
+
+    template<typename T>
+    void mul_into(MutableVectorView<T> out, VectorView<T> v1, VectorView<T> v2) {
+        if (out.data() != v1.data()) {
+            _check_dim(out.size(), v1.size());
+            std::copy(v1.cbegin(), v1.cend(), out.data());
+        }
+        out.mul(v2);
+    }
+
+    template<typename T>
+    void p_into(T& out, const T& v1, std::uint32_t times=1) {
+        if (&out != &v1) {
+            out = v1;
+        }
+        out.p(times);
+    }
 }
 
@@ -1,20 +1,48 @@
-#include <cassert>
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <cstdlib>
 #include <exception>
-#include <fstream>
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include <argparse/argparse.hpp>
 
+#include "Arena.hpp"
 #include "AssociativeMemory.hpp"
+#include "Corpus.hpp"
 #include "ItemMemory.hpp"
+#include "NgramMemory.hpp"
+#include "Profiler.hpp"
+#include "TextEncoder.hpp"
+#include "TextNormalizer.hpp"
+#include "ThreadPool.hpp"
 #include "common_args.hpp"
 #include "hdc.hpp"
 
-using lang_t = std::vector<std::string>;
+using lang_t = hdc::Corpus;
 using dataset_t = std::vector<lang_t>;
+using symbols_t = std::vector<std::uint8_t>;
+
+// The IM is a 27-entry memory packed as 26 letters and the space (' ') entry
+const std::size_t _ALPHABET = 27;
+const std::size_t _NGRAM = 3;
+
+// Iterations per chunk of work given to the thread pool
+const std::size_t _LINES_GRAIN = 256;
+const std::size_t _NGRAMS_GRAIN = 512;
+const std::size_t _SENTENCES_GRAIN = 16;
+
+// Maps raw text to IM indexes: a-z/A-Z to 0-25 and any other byte to the space
+// entry 26
+static hdc::TextNormalizer g_normalizer(false);
 
 std::vector<std::string> languages = {
     "bul",
@@ -41,20 +69,10 @@ std::vector<std::string> languages = {
 };
 
 // Dataset parsers
+// Each language file is memory mapped and its lines are views into the
+// mapping
 lang_t read_lang_file(const std::string &path) {
-    std::ifstream f(path);
-    if (!f.is_open()) {
-        std::cerr << "Could not open file: " << path << std::endl;
-        assert(f.is_open());
-    }
-    lang_t lines;
-
-    std::string line;
-    while (std::getline(f, line)) {
-        lines.emplace_back(line);
-    }
-
-    return lines;
+    return lang_t(path);
 }
 
 dataset_t read_dataset(const std::string &dataset_path) {
@@ -68,78 +86,239 @@ dataset_t read_dataset(const std::string &dataset_path) {
     return dataset;
 }
 
-template<typename VectorType>
-VectorType encode_3gram(const hdc::ItemMemory<VectorType> &im, const char *str) {
-    // ASCII table offset to the first lower char, i.e., the letter "a". The IM
-    // is 27-entry memory packed as 26 letters and the space (' ') entry. The
-    // input text in the *str variable must contain only lower-case letters
-    // without punctuation.
-    const int FIRST_lOWER_CHAR = 97;
-    std::vector<VectorType> items;
-    for (int i = 0; i < 3; i++, str++) {
-        if (*str != ' ') {
-            // Assign the lower-case letter to its IM correspondent
-            items.emplace_back(im.at(*str-FIRST_lOWER_CHAR));
-        }
-        else {
-            // Assign the space char as the last item in the IM
-            items.emplace_back(im.back());
-        }
-    }
-    // Permute the items
-    items[0] = hdc::p(items[0], 2);
-    items[1] = hdc::p(items[1], 1);
+// Normalize a line into the stream of IM indexes consumed by the encoders.
+// Each thread reuses its own buffer.
+const symbols_t &normalize_line(std::string_view line) {
+    thread_local symbols_t symbols;
+    symbols.clear();
+    g_normalizer.normalize(line, symbols);
+    return symbols;
+}
 
-    // Return the trigram HV
-    return hdc::mul(items);
+template<typename VectorType>
+VectorType encode_query(
+        const hdc::ItemMemory<VectorType> &im,
+        const hdc::NgramMemory<VectorType> *ngrams,
+        const symbols_t &symbols
+        ) {
+    // The trigram HV is p(s_0, 2) * p(s_1, 1) * s_2, read from the n-gram
+    // table when available. Trigrams are taken while there is a symbol after
+    // them.
+    return hdc::encode_text(im, ngrams, symbols.data(), symbols.size(), _NGRAM);
 }
 
+/**
+ * Streaming classification of long texts. The trigrams are bundled into a
+ * running accumulator while the text is consumed, and the AM is searched every
+ * "interval" characters. Classification stops as soon as the distance margin
+ * between the best and the second best language reaches "confidence".
+ */
 template<typename VectorType>
-VectorType encode_query(const hdc::ItemMemory<VectorType> &im, const char *str) {
-    std::vector<VectorType> n_grams;
-
-    // Encode n-grams. Since we create 3-grams, loop until the pointer of str+3
-    // is different from the null character.
-    while (*(str+3)) {
-        n_grams.emplace_back(encode_3gram(im, str));
-        str++;
+class StreamClassifier
+{
+public:
+    struct result_t {
+        std::size_t label;    // Predicted language
+        std::size_t consumed; // Characters read before deciding
+        float margin;         // Distance margin of the decision
+    };
+
+    StreamClassifier(
+            const hdc::ItemMemory<VectorType> &im,
+            const hdc::NgramMemory<VectorType> *ngrams,
+            const hdc::AssociativeMemory<VectorType> &am,
+            float confidence,
+            std::size_t interval
+            ) : _im(im), _ngrams(ngrams), _am(am),
+                _confidence(confidence), _interval(interval ? interval : 1) {}
+
+    result_t classify(std::string_view text) const {
+        // The stream bundles the same trigrams as encode_query() over the
+        // whole text
+        hdc::TextStream<VectorType> stream(g_normalizer, this->_im, this->_ngrams, _NGRAM);
+        result_t res = {0, 0, 0.0};
+
+        while (res.consumed < text.size()) {
+            std::size_t len = std::min(this->_interval, text.size()-res.consumed);
+            stream.feed(text.substr(res.consumed, len));
+            res.consumed += len;
+
+            if (stream.ngrams()) {
+                res.label = this->_am.search(stream.result(), res.margin);
+                if (res.margin >= this->_confidence) {
+                    break;
+                }
+            }
+        }
+
+        return res;
     }
 
-    return hdc::add(n_grams);
-}
+private:
+    const hdc::ItemMemory<VectorType> &_im;
+    const hdc::NgramMemory<VectorType> *_ngrams;
+    const hdc::AssociativeMemory<VectorType> &_am;
+    float _confidence;
+    std::size_t _interval;
+};
 
 template<typename VectorType>
 VectorType train_language(
         const hdc::ItemMemory<VectorType> &im,
+        const hdc::NgramMemory<VectorType> *ngrams,
         const lang_t &lang
         ) {
-    std::vector<VectorType> query_vectors;
+    // Encode the lines in parallel and bundle them into per-chunk
+    // accumulators instead of keeping every encoded line
+    auto acc = hdc::ThreadPool::global().parallel_reduce(
+            0, lang.size(), _LINES_GRAIN,
+            hdc::Accumulator<VectorType>(im.at(0).size()),
+            [&](hdc::Accumulator<VectorType> &partial, std::size_t i) {
+                partial.add(encode_query(im, ngrams, normalize_line(lang[i])));
+            },
+            [](hdc::Accumulator<VectorType> &res,
+               const hdc::Accumulator<VectorType> &partial) {
+                res.merge(partial);
+            });
+
+    return acc.result();
+}
+
+// Train a language profile from its trigram histogram. The corpus is scanned
+// once to count how often each trigram occurs, then every distinct trigram
+// is bundled once with its count as weight. The training time depends on the
+// number of distinct trigrams instead of on the corpus length, which is
+// returned in "distinct".
+template<typename VectorType>
+VectorType train_language_histogram(
+        const hdc::ItemMemory<VectorType> &im,
+        const hdc::NgramMemory<VectorType> *ngrams,
+        const lang_t &lang,
+        hdc::dim_t dim,
+        std::size_t &distinct
+        ) {
+    const std::size_t entries = hdc::NgramMemory<VectorType>::entries(_ALPHABET, _NGRAM);
+    std::vector<std::uint32_t> histogram(entries, 0);
 
     for (auto &line : lang) {
-        const char *line_ptr = line.c_str();
-        query_vectors.emplace_back(encode_query(im, line_ptr));
+        const auto &symbols = normalize_line(line);
+        // Same trigrams as encode_query(): the last trigram of a line is the
+        // one ending right before its last symbol
+        std::size_t idx = 0;
+        for (std::size_t i = 0; i+1 < symbols.size(); i++) {
+            idx = (idx * _ALPHABET + symbols[i]) % entries;
+            if (i+1 >= _NGRAM) {
+                histogram[idx]++;
+            }
+        }
     }
 
-    return hdc::add(query_vectors);
+    distinct = std::count_if(histogram.cbegin(), histogram.cend(),
+                             [](std::uint32_t count) { return count > 0; });
+
+    auto acc = hdc::ThreadPool::global().parallel_reduce(
+            0, entries, _NGRAMS_GRAIN,
+            hdc::Accumulator<VectorType>(dim),
+            [&](hdc::Accumulator<VectorType> &partial, std::size_t idx) {
+                if (!histogram[idx]) {
+                    return;
+                }
+
+                if (ngrams) {
+                    partial.add(ngrams->view(idx), histogram[idx]);
+                }
+                else {
+                    std::size_t symbols[_NGRAM];
+                    for (std::size_t k = _NGRAM, rem = idx; k-- > 0; rem /= _ALPHABET) {
+                        symbols[k] = rem % _ALPHABET;
+                    }
+                    hdc::ScopedArena arena;
+                    partial.add(hdc::NgramMemory<VectorType>::encode(
+                                    im, symbols, _NGRAM, arena.resource()),
+                                histogram[idx]);
+                }
+            },
+            [](hdc::Accumulator<VectorType> &res,
+               const hdc::Accumulator<VectorType> &partial) {
+                res.merge(partial);
+            });
+
+    return acc.result();
 }
 
 template<typename VectorType>
 std::size_t test_language(
         const hdc::ItemMemory<VectorType> &im,
+        const hdc::NgramMemory<VectorType> *ngrams,
         const hdc::AssociativeMemory<VectorType> &am,
         const lang_t &lang,
         const std::size_t right_answer
         ) {
-    std::size_t correct = 0;
+    return hdc::ThreadPool::global().parallel_reduce(
+            0, lang.size(), _SENTENCES_GRAIN, std::size_t(0),
+            [&](std::size_t &correct, std::size_t i) {
+                auto query = encode_query(im, ngrams, normalize_line(lang[i]));
+                std::size_t prediction = am.search(query);
+                correct += (prediction == right_answer) ? 1 : 0;
+            },
+            [](std::size_t &res, std::size_t partial) { res += partial; });
+}
+
+// Test with early exit. Returns the number of correct predictions and the
+// number of characters consumed from the sentences.
+template<typename VectorType>
+std::pair<std::size_t, std::size_t> test_language_stream(
+        const StreamClassifier<VectorType> &classifier,
+        const lang_t &lang,
+        const std::size_t right_answer
+        ) {
+    using count_t = std::pair<std::size_t, std::size_t>;
+    return hdc::ThreadPool::global().parallel_reduce(
+            0, lang.size(), _SENTENCES_GRAIN, count_t(0, 0),
+            [&](count_t &count, std::size_t i) {
+                auto res = classifier.classify(lang[i]);
+                count.first += (res.label == right_answer) ? 1 : 0;
+                count.second += res.consumed;
+            },
+            [](count_t &res, const count_t &partial) {
+                res.first += partial.first;
+                res.second += partial.second;
+            });
+}
+
+template <typename VectorType>
+void save_model(const argparse::ArgumentParser &args,
+                const hdc::ItemMemory<VectorType> &im,
+                const hdc::NgramMemory<VectorType> *ngrams,
+                const hdc::AssociativeMemory<VectorType> &am) {
+    auto path = args.get("--save-model");
+    im.save(path+"/./im.txt");
+    am.save(path+"/./am.txt");
+    if (ngrams) {
+        ngrams->save(path+"/./ngram.bin");
+    }
+}
+
+// Build the n-gram table if it was requested and fits in the memory budget
+template<typename VectorType>
+std::unique_ptr<hdc::NgramMemory<VectorType>> make_ngram_table(
+        const argparse::ArgumentParser& args,
+        const hdc::ItemMemory<VectorType> &im,
+        hdc::dim_t dim
+        ) {
+    if (!args.get<bool>("--ngram-table")) {
+        return nullptr;
+    }
 
-    for (auto &sentence : lang) {
-        const char *str = sentence.c_str();
-        auto query = encode_query(im, str);
-        std::size_t prediction = am.search(query);
-        correct += (prediction == right_answer) ? 1 : 0;
+    std::size_t budget = args.get<size_t>("--ngram-budget") << 20;
+    std::size_t footprint = hdc::NgramMemory<VectorType>::footprint(_ALPHABET, _NGRAM, dim);
+    if (footprint > budget) {
+        std::cout << "N-gram table needs " << (footprint >> 20) << " MiB and "
+            "exceeds the budget. Encoding trigrams on the fly." << std::endl;
+        return nullptr;
     }
 
-    return correct;
+    return std::make_unique<hdc::NgramMemory<VectorType>>(im, _NGRAM);
 }
 
 template<typename VectorType>
@@ -151,27 +330,118 @@ int language(const argparse::ArgumentParser& args) {
     //    " D: " << dim << std::endl;
     std::cout << " D: " << dim << std::endl;
 
-    const auto &dataset = read_dataset(args.get("train_dir"));
+    hdc::ScopedTimer read_timer("read");
     const auto &testset = read_dataset(args.get("test_dir"));
+    for (const auto &lang : testset) {
+        read_timer.samples(lang.size());
+    }
+    read_timer.stop();
 
-    auto im = hdc::ItemMemory<VectorType>(27, dim);
+    std::unique_ptr<hdc::ItemMemory<VectorType>> im;
+    std::unique_ptr<hdc::NgramMemory<VectorType>> ngrams;
+    std::unique_ptr<hdc::AssociativeMemory<VectorType>> am;
 
-    std::vector<VectorType> trained_languages;
-    for (auto &lang : dataset) {
-        trained_languages.emplace_back(train_language(im, lang));
+    if (!args.is_used("--load-model")) {
+        hdc::ScopedTimer train_read_timer("read");
+        const auto &dataset = read_dataset(args.get("train_dir"));
+        for (const auto &lang : dataset) {
+            train_read_timer.samples(lang.size());
+        }
+        train_read_timer.stop();
+
+        hdc::ScopedTimer memories_timer("memories");
+        im = std::make_unique<hdc::ItemMemory<VectorType>>(_ALPHABET, dim);
+        ngrams = make_ngram_table(args, *im, dim);
+        memories_timer.encodes(ngrams ? ngrams->size() : 0);
+        memories_timer.stop();
+
+        // Languages are trained independently
+        hdc::ScopedTimer train_timer("train");
+        for (const auto &lang : dataset) {
+            train_timer.samples(lang.size());
+        }
+        bool histogram = args.get<bool>("--histogram");
+        std::vector<VectorType> trained_languages(dataset.size(), VectorType(dim, false));
+        // Sentences encoded, or distinct trigrams bundled with --histogram
+        std::vector<std::size_t> encoded(dataset.size(), 0);
+        hdc::ThreadPool::global().parallel_for(0, dataset.size(), [&](std::size_t i) {
+            if (histogram) {
+                trained_languages[i] = train_language_histogram(
+                        *im, ngrams.get(), dataset[i], dim, encoded[i]);
+            }
+            else {
+                trained_languages[i] = train_language(*im, ngrams.get(), dataset[i]);
+                encoded[i] = dataset[i].size();
+            }
+        });
+        for (auto n : encoded) {
+            train_timer.encodes(n);
+        }
+        am = std::make_unique<hdc::AssociativeMemory<VectorType>>(trained_languages);
+        train_timer.stop();
+
+        if (args.is_used("--save-model")) {
+            save_model(args, *im, ngrams.get(), *am);
+        }
+    }
+    else {
+        hdc::ScopedTimer memories_timer("memories");
+        auto path = args.get("--load-model");
+        im = std::make_unique<hdc::ItemMemory<VectorType>>(path+"/./im.txt");
+        am = std::make_unique<hdc::AssociativeMemory<VectorType>>(path+"/./am.txt");
+        // The n-gram table is optional in a saved model
+        if (std::filesystem::is_regular_file(path+"/./ngram.bin")) {
+            ngrams = std::make_unique<hdc::NgramMemory<VectorType>>(
+                    path+"/./ngram.bin", _ALPHABET, _NGRAM);
+            if (ngrams->dim() != im->at(0).size()) {
+                throw std::runtime_error("N-gram table in " + path + " does not "
+                                         "match the dimension of the IM.");
+            }
+        }
     }
 
-    hdc::AssociativeMemory<VectorType> am(trained_languages);
-    std::vector<std::size_t> correct;
-    for (std::size_t i = 0; i < testset.size(); i++) {
+    hdc::ScopedTimer test_timer("test");
+    std::vector<std::size_t> correct(testset.size());
+    // Characters consumed by the early-exit classifier and total characters
+    std::vector<std::size_t> consumed(testset.size());
+    std::vector<std::size_t> characters(testset.size());
+    bool early_exit = args.is_used("--early-exit");
+    StreamClassifier<VectorType> classifier(
+            *im, ngrams.get(), *am,
+            args.get<float>("--early-exit"),
+            args.get<size_t>("--stream-interval"));
+
+    hdc::ThreadPool::global().parallel_for(0, testset.size(), [&](std::size_t i) {
         const auto &lang = testset[i];
-        correct.emplace_back(test_language(im, am, lang, i));
+        if (early_exit) {
+            std::tie(correct[i], consumed[i]) = test_language_stream(classifier, lang, i);
+            for (auto &sentence : lang) {
+                characters[i] += sentence.size();
+            }
+        }
+        else {
+            correct[i] = test_language(*im, ngrams.get(), *am, lang, i);
+        }
+    });
+    for (const auto &lang : testset) {
+        test_timer.samples(lang.size());
+        test_timer.encodes(lang.size());
+        // Early exit searches a variable number of times per sentence
+        if (!early_exit) {
+            test_timer.searches(lang.size());
+        }
     }
+    test_timer.stop();
 
     // Print results summary
     for (std::size_t i = 0; i < languages.size(); i++) {
         std::cout << languages[i] << ": " << correct[i] << "\t"
-            << (float)correct[i]/1000*100 << "%" << std::endl;
+            << (float)correct[i]/1000*100 << "%";
+        if (early_exit) {
+            std::cout << "\tconsumed: "
+                << (float)consumed[i]/characters[i]*100 << "%";
+        }
+        std::cout << std::endl;
     }
 
     return 0;
@@ -185,15 +455,47 @@ auto add_args(argparse::ArgumentParser& program) {
 
     // Optional arguments
     common_args::add_args(program);
-    //program.add_argument("--load-model")
-    //    .help("Load model from path and only execute the test stage. The path "
-    //          "given must be of a directory containing the data for the IM, "
-    //          "CIM, and AM.");
-    //program.add_argument("--save-model")
-    //    .help("Write all used memories to the given path. The files are "
-    //          "created according to the name of the memory. ItemMemory is "
-    //          "saved as im.txt, ContinuousItemMemory as cim.txt, and "
-    //          "AssociativeMemory as am.txt");
+    program.add_argument("--ngram-table")
+        .help("Precompute the hypervector of every trigram and encode text "
+              "with table lookups.")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--collapse-spaces")
+        .help("Collapse runs of spaces, digits and punctuation into a single "
+              "space before encoding.")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--histogram")
+        .help("Train each language as the bundle of its distinct trigrams "
+              "weighted by their frequency instead of bundling the encoding "
+              "of every line.")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--early-exit")
+        .help("Classify each test sentence as a stream and stop as soon as "
+              "the distance margin between the two closest languages reaches "
+              "the given value.")
+        .scan<'g', float>()
+        .default_value<float>(0.0);
+    program.add_argument("--stream-interval")
+        .help("Characters consumed between two searches with --early-exit.")
+        .scan<'d', size_t>()
+        .default_value<size_t>(32);
+    program.add_argument("--ngram-budget")
+        .help("Maximum memory in MiB used by the n-gram table. The table is "
+              "not built if it does not fit.")
+        .scan<'d', size_t>()
+        .default_value<size_t>(1024);
+
+    program.add_argument("--load-model")
+        .help("Load model from path and only execute the test stage. The path "
+              "given must be of a directory containing the data for the IM "
+              "and AM, and optionally the n-gram table.");
+    program.add_argument("--save-model")
+        .help("Write all used memories to the given path. The files are "
+              "created according to the name of the memory. ItemMemory is "
+              "saved as im.txt, AssociativeMemory as am.txt, and the n-gram "
+              "table as ngram.bin, which is mapped when the model is loaded");
 
     return program;
 }
@@ -204,12 +506,19 @@ int main(int argc, char *argv[]) {
     try {
         add_args(args);
         args.parse_args(argc, argv);
+        bitmanip::set_isa(args.get("--isa"));
+        common_args::check_profile(args);
     } catch (const std::runtime_error& e) {
         std::cout << args << std::endl;
         std::cerr << "Failed to parse arguments! " << e.what() << std::endl;
         return -1;
     }
 
+    hdc::ThreadPool::set_threads(args.get<size_t>("--threads"));
+    std::srand(args.get<unsigned int>("--seed"));
+    g_normalizer.set_collapse(args.get<bool>("--collapse-spaces"));
+    common_args::ProfileReport profile(args, "language");
+
     auto hdc = args.get("hdc");
 
     if (hdc == "bin") {
@@ -1,7 +1,49 @@
+#pragma once
+
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <string>
 
 namespace bitmanip {
+    /**
+     * @brief Instruction sets of the kernels.
+     *
+     * Every kernel is built for each instruction set and the best one that
+     * the CPU supports is selected the first time a kernel is called. All
+     * sets give the same results.
+     */
+    enum class isa_t {
+        scalar,     // Portable code
+        sse42,      // SSE4.2 and POPCNT
+        avx2,       // AVX2, BMI and BMI2
+    };
+
+    const char* isa_name(isa_t isa);
+
+    // Whether the CPU can run the kernels of an instruction set
+    bool supported(isa_t isa);
+
+    // Instruction set of the kernels being used
+    isa_t isa();
+
+    /**
+     * @brief Use the kernels of another instruction set.
+     *
+     * @param isa: Instruction set. Throws std::runtime_error if the CPU does
+     * not support it.
+     */
+    void set_isa(isa_t isa);
+
+    /**
+     * @brief Use the kernels of the instruction set with the given name.
+     *
+     * @param name: "scalar", "sse4.2", "avx2" or "auto". "auto" uses the set
+     * named by the LIBBIN_ISA environment variable if it is given, or the
+     * best set supported by the CPU otherwise.
+     */
+    void set_isa(const std::string& name);
+
     bool get_bit(uint32_t val, uint32_t pos);
 
     /**
@@ -18,5 +60,77 @@ namespace bitmanip {
         uint32_t val,
         std::array<uint32_t, 32> &acc
     );
-}
 
+    /**
+     * @brief Add "weight" to the counters of the set bits of "val" and
+     * subtract it from the counters of the cleared bits.
+     *
+     * @param val: Bit packed value.
+     * @param weight: Weight of the value.
+     * @param acc: 32 signed counters, acc[i] holds the counter of bit i.
+     */
+    void accumulate_weighted(
+        uint32_t val,
+        int32_t weight,
+        int32_t *acc
+    );
+
+    /**
+     * @brief accumulate_weighted() of n words. The counters of word w start
+     * at acc[32*w].
+     */
+    void accumulate_weighted(
+        const uint32_t *words,
+        std::size_t n,
+        int32_t weight,
+        int32_t *acc
+    );
+
+    /**
+     * @brief Pack the sign of 32 signed counters. Bit i is set if acc[i] is
+     * greater than zero.
+     */
+    uint32_t sign_pack(const int32_t *acc);
+
+    /**
+     * @brief sign_pack() of the counters of n words into out[0..n).
+     */
+    void sign_pack(const int32_t *acc, std::size_t n, uint32_t *out);
+
+    /**
+     * @brief Majority of the XOR of n pairs of word arrays.
+     *
+     * Bit i of out[w] is set if bit i of a[k][w] ^ b[k][w] is set for more
+     * than "threshold" of the n pairs. The bits are counted with bit-sliced
+     * counters, so each word is read once and no per-bit counters are kept.
+     *
+     * @param a: n pointers to arrays of "words" words.
+     * @param b: n pointers to arrays of "words" words.
+     * @param out: Array of "words" words receiving the majority.
+     */
+    void xor_majority(
+        const uint32_t *const *a,
+        const uint32_t *const *b,
+        std::size_t n,
+        std::size_t words,
+        uint32_t threshold,
+        uint32_t *out
+    );
+
+    /**
+     * @brief Majority of n word arrays, counted the same way as
+     * xor_majority().
+     */
+    void majority(
+        const uint32_t *const *a,
+        std::size_t n,
+        std::size_t words,
+        uint32_t threshold,
+        uint32_t *out
+    );
+
+    /**
+     * @brief Number of bits that differ between two arrays of "words" words.
+     */
+    uint64_t hamming(const uint32_t *a, const uint32_t *b, std::size_t words);
+}
@@ -0,0 +1,247 @@
+#include <cstddef>
+#include <cstdint>
+#include <immintrin.h>
+
+#include "kernels.hpp"
+
+// Kernels for AVX2, BMI and BMI2, eight 32-bit lanes at a time
+namespace bitmanip::avx2 {
+    static void _unpack(uint32_t val, uint32_t *out) {
+        // Cast val to 64-bit to allow using _pdep64
+        auto a = static_cast<uint64_t>(val);
+        constexpr auto unpack_size = sizeof(a);
+        uint64_t mask = 0x0101010101010101;
+        uint64_t unp_bits[2] = {0, 0};
+        for (std::size_t pos = 0; pos < 32; pos += unpack_size) {
+            // Unpack 8 bits into 8 8-bit elements
+            unp_bits[0] = _pdep_u64(a, mask);
+            a >>= unpack_size;
+
+            // Convert the 8 elements of 8-bit to a 8 32-bit elements
+            __m128i unp_8bits = _mm_lddqu_si128((__m128i*)&unp_bits);
+            __m256i unp_32bits = _mm256_cvtepu8_epi32(unp_8bits);
+
+            // Store the 8 32-bit elements in the return array
+            _mm256_storeu_si256((__m256i*)(out+pos), unp_32bits);
+        }
+    }
+
+    static void _accumulate_unpacked(uint32_t val, uint32_t *acc) {
+        alignas(32) uint32_t unp[32];
+        _unpack(val, unp);
+
+        auto acc_ptr = (__m256i*) acc;
+        auto unp_ptr = (const __m256i*) unp;
+        for (std::size_t i = 0; i < 4; i++) {
+            __m256i temp_acc = _mm256_lddqu_si256(acc_ptr+i);
+            __m256i temp_unp = _mm256_load_si256(unp_ptr+i);
+
+            // Adopting 32b int add since AVX256 does not dispose unsigned add
+            // for 32b
+            temp_acc = _mm256_add_epi32(temp_acc, temp_unp);
+
+            _mm256_storeu_si256(acc_ptr+i, temp_acc);
+        }
+    }
+
+    static uint32_t _threshold_pack(const uint32_t *acc, uint32_t threshold) {
+        // There is no unsigned comparison, so both sides are offset by 2^31
+        // and compared as signed numbers
+        const __m256i bias = _mm256_set1_epi32(INT32_MIN);
+        __m256i biased_threshold = _mm256_xor_si256(_mm256_set1_epi32(threshold), bias);
+        auto acc_ptr = (const __m256i*) acc;
+        uint32_t word = 0;
+
+        for (int i = 0; i < 4; i++) {
+            __m256i temp_acc = _mm256_lddqu_si256(acc_ptr+i);
+            __m256i res = _mm256_cmpgt_epi32(_mm256_xor_si256(temp_acc, bias), biased_threshold);
+            // Gather the MSB of each 32-bit lane into an 8-bit mask
+            uint32_t bits = _mm256_movemask_ps(_mm256_castsi256_ps(res));
+            word |= bits << (i*8);
+        }
+
+        return word;
+    }
+
+    // Add +weight to the lanes of the set bits of "val" and -weight to the
+    // others. Each lane shifts its bit to the sign position, so the bits are
+    // turned into lane masks without going through memory.
+    static inline void _accumulate_weighted_word(
+            uint32_t val,
+            __m256i neg,
+            int32_t *acc
+        ) {
+        const __m256i shifts = _mm256_setr_epi32(31, 30, 29, 28, 27, 26, 25, 24);
+        __m256i broadcast = _mm256_set1_epi32(val);
+        auto acc_ptr = (__m256i*) acc;
+
+        for (std::size_t i = 0; i < 4; i++) {
+            // Lanes of the bits 8*i to 8*i+7, all ones if the bit is set
+            __m256i lanes = _mm256_sllv_epi32(broadcast, shifts);
+            __m256i mask = _mm256_srai_epi32(lanes, 31);
+            broadcast = _mm256_srli_epi32(broadcast, 8);
+
+            // -weight for cleared bits and +weight for set bits
+            __m256i temp_w = _mm256_sub_epi32(_mm256_xor_si256(neg, mask), mask);
+            __m256i temp_acc = _mm256_lddqu_si256(acc_ptr+i);
+            _mm256_storeu_si256(acc_ptr+i, _mm256_add_epi32(temp_acc, temp_w));
+        }
+    }
+
+    static void _accumulate_weighted(uint32_t val, int32_t weight, int32_t *acc) {
+        _accumulate_weighted_word(val, _mm256_set1_epi32(-weight), acc);
+    }
+
+    static void _accumulate_weighted_words(
+            const uint32_t *words,
+            std::size_t n,
+            int32_t weight,
+            int32_t *acc
+        ) {
+        const __m256i neg = _mm256_set1_epi32(-weight);
+        for (std::size_t w = 0; w < n; w++) {
+            _accumulate_weighted_word(words[w], neg, acc+32*w);
+        }
+    }
+
+    static uint32_t _sign_pack(const int32_t *acc) {
+        auto acc_ptr = (const __m256i*) acc;
+        uint32_t word = 0;
+
+        for (int i = 0; i < 4; i++) {
+            __m256i temp_acc = _mm256_lddqu_si256(acc_ptr+i);
+            __m256i res = _mm256_cmpgt_epi32(temp_acc, _mm256_setzero_si256());
+            // Gather the MSB of each 32-bit lane into an 8-bit mask
+            uint32_t bits = _mm256_movemask_ps(_mm256_castsi256_ps(res));
+            word |= bits << (i*8);
+        }
+
+        return word;
+    }
+
+    static void _sign_pack_words(const int32_t *acc, std::size_t n, uint32_t *out) {
+        for (std::size_t w = 0; w < n; w++) {
+            out[w] = _sign_pack(acc+32*w);
+        }
+    }
+
+    // Bit-sliced majority of eight words at once. load8(k, w) returns the
+    // words w to w+7 of the input k.
+    template<typename Load8>
+    static std::size_t _bitsliced_majority(
+            Load8 load8,
+            std::size_t n,
+            std::size_t words,
+            uint32_t threshold,
+            uint32_t *out
+        ) {
+        const std::size_t planes = _planes(n);
+        __m256i count[_MAX_PLANES];
+
+        std::size_t w = 0;
+        for (; w + 8 <= words; w += 8) {
+            for (std::size_t p = 0; p < planes; p++) {
+                count[p] = _mm256_setzero_si256();
+            }
+
+            for (std::size_t k = 0; k < n; k++) {
+                __m256i carry = load8(k, w);
+                for (std::size_t p = 0; p < planes && !_mm256_testz_si256(carry, carry); p++) {
+                    __m256i next = _mm256_and_si256(count[p], carry);
+                    count[p] = _mm256_xor_si256(count[p], carry);
+                    carry = next;
+                }
+            }
+
+            __m256i gt = _mm256_setzero_si256();
+            __m256i eq = _mm256_set1_epi32(-1);
+            for (std::size_t p = planes; p-- > 0;) {
+                if ((threshold >> p) & 1) {
+                    eq = _mm256_and_si256(eq, count[p]);
+                }
+                else {
+                    gt = _mm256_or_si256(gt, _mm256_and_si256(eq, count[p]));
+                    eq = _mm256_andnot_si256(count[p], eq);
+                }
+            }
+            _mm256_storeu_si256((__m256i*)(out+w), gt);
+        }
+
+        // First word that was not counted
+        return w;
+    }
+
+    static void _xor_majority(
+            const uint32_t *const *a,
+            const uint32_t *const *b,
+            std::size_t n,
+            std::size_t words,
+            uint32_t threshold,
+            uint32_t *out
+        ) {
+        auto load8 = [a, b](std::size_t k, std::size_t w) {
+            return _mm256_xor_si256(
+                    _mm256_lddqu_si256((const __m256i*)(a[k]+w)),
+                    _mm256_lddqu_si256((const __m256i*)(b[k]+w)));
+        };
+        std::size_t w = _bitsliced_majority(load8, n, words, threshold, out);
+        scalar::xor_majority_range(a, b, n, w, words, threshold, out);
+    }
+
+    static void _majority(
+            const uint32_t *const *a,
+            std::size_t n,
+            std::size_t words,
+            uint32_t threshold,
+            uint32_t *out
+        ) {
+        auto load8 = [a](std::size_t k, std::size_t w) {
+            return _mm256_lddqu_si256((const __m256i*)(a[k]+w));
+        };
+        std::size_t w = _bitsliced_majority(load8, n, words, threshold, out);
+        scalar::majority_range(a, n, w, words, threshold, out);
+    }
+
+    static uint64_t _hamming(const uint32_t *a, const uint32_t *b, std::size_t words) {
+        // Population count of each nibble, looked up with a byte shuffle
+        const __m256i lookup = _mm256_setr_epi8(
+                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i low_nibbles = _mm256_set1_epi8(0x0F);
+        __m256i total = _mm256_setzero_si256();
+
+        std::size_t w = 0;
+        for (; w + 8 <= words; w += 8) {
+            __m256i diff = _mm256_xor_si256(
+                    _mm256_lddqu_si256((const __m256i*)(a+w)),
+                    _mm256_lddqu_si256((const __m256i*)(b+w)));
+            __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(diff, low_nibbles));
+            __m256i hi = _mm256_shuffle_epi8(lookup,
+                    _mm256_and_si256(_mm256_srli_epi16(diff, 4), low_nibbles));
+            // Add the byte counts of each 64-bit lane
+            __m256i bytes = _mm256_add_epi8(lo, hi);
+            total = _mm256_add_epi64(total, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+        }
+
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256((__m256i*)lanes, total);
+        uint64_t res = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        for (; w < words; w++) {
+            res += _mm_popcnt_u32(a[w] ^ b[w]);
+        }
+        return res;
+    }
+
+    const kernels_t kernels = {
+        _unpack,
+        _accumulate_unpacked,
+        _threshold_pack,
+        _accumulate_weighted,
+        _accumulate_weighted_words,
+        _sign_pack,
+        _sign_pack_words,
+        _xor_majority,
+        _majority,
+        _hamming,
+    };
+}
@@ -0,0 +1,182 @@
+#include <cstddef>
+#include <cstdint>
+
+#include "kernels.hpp"
+
+// Portable kernels, compiled without any ISA flags
+namespace bitmanip::scalar {
+    static void _unpack(uint32_t val, uint32_t *out) {
+        for (std::size_t pos = 0; pos < 32; pos++) {
+            out[pos] = (val >> pos) & 1;
+        }
+    }
+
+    static void _accumulate_unpacked(uint32_t val, uint32_t *acc) {
+        for (std::size_t pos = 0; pos < 32; pos++) {
+            acc[pos] += (val >> pos) & 1;
+        }
+    }
+
+    static uint32_t _threshold_pack(const uint32_t *acc, uint32_t threshold) {
+        // Write the result's vector bit_group
+        uint32_t word = 0;
+        constexpr int pack_size = 32;
+        for (std::size_t pos = 0; pos < pack_size; pos++) {
+            // Decide the bit majority of the accumulator entries
+            uint32_t bit = acc[pack_size-pos-1] > threshold;
+            // Set bit
+            word <<= 1;
+            word |= bit;
+        }
+
+        return word;
+    }
+
+    static void _accumulate_weighted(uint32_t val, int32_t weight, int32_t *acc) {
+        for (std::size_t pos = 0; pos < 32; pos++) {
+            acc[pos] += ((val >> pos) & 1) ? weight : -weight;
+        }
+    }
+
+    static uint32_t _sign_pack(const int32_t *acc) {
+        uint32_t word = 0;
+        for (std::size_t pos = 0; pos < 32; pos++) {
+            word |= (uint32_t)(acc[pos] > 0) << pos;
+        }
+
+        return word;
+    }
+
+    static void _accumulate_weighted_words(
+            const uint32_t *words,
+            std::size_t n,
+            int32_t weight,
+            int32_t *acc
+        ) {
+        for (std::size_t w = 0; w < n; w++) {
+            _accumulate_weighted(words[w], weight, acc+32*w);
+        }
+    }
+
+    static void _sign_pack_words(const int32_t *acc, std::size_t n, uint32_t *out) {
+        for (std::size_t w = 0; w < n; w++) {
+            out[w] = _sign_pack(acc+32*w);
+        }
+    }
+
+    // The counted words are given by load(k, w), the word w of the input k
+    template<typename Load>
+    static void _bitsliced_majority(
+            Load load,
+            std::size_t n,
+            std::size_t begin,
+            std::size_t end,
+            uint32_t threshold,
+            uint32_t *out
+        ) {
+        const std::size_t planes = _planes(n);
+        uint32_t count[_MAX_PLANES];
+
+        for (std::size_t w = begin; w < end; w++) {
+            for (std::size_t p = 0; p < planes; p++) { count[p] = 0; }
+
+            for (std::size_t k = 0; k < n; k++) {
+                uint32_t carry = load(k, w);
+                for (std::size_t p = 0; carry && p < planes; p++) {
+                    uint32_t next = count[p] & carry;
+                    count[p] ^= carry;
+                    carry = next;
+                }
+            }
+
+            uint32_t gt = 0;
+            uint32_t eq = ~0u;
+            for (std::size_t p = planes; p-- > 0;) {
+                if ((threshold >> p) & 1) {
+                    eq &= count[p];
+                }
+                else {
+                    gt |= eq & count[p];
+                    eq &= ~count[p];
+                }
+            }
+            out[w] = gt;
+        }
+    }
+
+    void xor_majority_range(
+            const uint32_t *const *a,
+            const uint32_t *const *b,
+            std::size_t n,
+            std::size_t begin,
+            std::size_t end,
+            uint32_t threshold,
+            uint32_t *out
+        ) {
+        auto load = [a, b](std::size_t k, std::size_t w) {
+            return a[k][w] ^ b[k][w];
+        };
+        _bitsliced_majority(load, n, begin, end, threshold, out);
+    }
+
+    void majority_range(
+            const uint32_t *const *a,
+            std::size_t n,
+            std::size_t begin,
+            std::size_t end,
+            uint32_t threshold,
+            uint32_t *out
+        ) {
+        auto load = [a](std::size_t k, std::size_t w) {
+            return a[k][w];
+        };
+        _bitsliced_majority(load, n, begin, end, threshold, out);
+    }
+
+    static void _xor_majority(
+            const uint32_t *const *a,
+            const uint32_t *const *b,
+            std::size_t n,
+            std::size_t words,
+            uint32_t threshold,
+            uint32_t *out
+        ) {
+        xor_majority_range(a, b, n, 0, words, threshold, out);
+    }
+
+    static void _majority(
+            const uint32_t *const *a,
+            std::size_t n,
+            std::size_t words,
+            uint32_t threshold,
+            uint32_t *out
+        ) {
+        majority_range(a, n, 0, words, threshold, out);
+    }
+
+    static uint64_t _hamming(const uint32_t *a, const uint32_t *b, std::size_t words) {
+        uint64_t res = 0;
+        for (std::size_t w = 0; w < words; w++) {
+            // Count the set bits of the pairs, nibbles and bytes in parallel
+            uint32_t diff = a[w] ^ b[w];
+            diff = diff - ((diff >> 1) & 0x55555555);
+            diff = (diff & 0x33333333) + ((diff >> 2) & 0x33333333);
+            diff = (diff + (diff >> 4)) & 0x0F0F0F0F;
+            res += (diff * 0x01010101) >> 24;
+        }
+        return res;
+    }
+
+    const kernels_t kernels = {
+        _unpack,
+        _accumulate_unpacked,
+        _threshold_pack,
+        _accumulate_weighted,
+        _accumulate_weighted_words,
+        _sign_pack,
+        _sign_pack_words,
+        _xor_majority,
+        _majority,
+        _hamming,
+    };
+}
@@ -0,0 +1,197 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+#include "kernels.hpp"
+
+// Kernels for SSE4.2 and POPCNT, four 32-bit lanes at a time
+namespace bitmanip::sse42 {
+    // Lane mask of the bits 4*k to 4*k+3 of "val". Lane i is all ones if
+    // bit 4*k+i is set.
+    static inline __m128i _bit_mask(uint32_t val, int k) {
+        const __m128i bits = _mm_setr_epi32(1, 2, 4, 8);
+        __m128i select = _mm_sll_epi32(bits, _mm_cvtsi32_si128(4*k));
+        __m128i masked = _mm_and_si128(_mm_set1_epi32(val), select);
+        return _mm_cmpeq_epi32(masked, select);
+    }
+
+    static void _unpack(uint32_t val, uint32_t *out) {
+        for (int k = 0; k < 8; k++) {
+            __m128i unp = _mm_srli_epi32(_bit_mask(val, k), 31);
+            _mm_storeu_si128((__m128i*)(out+4*k), unp);
+        }
+    }
+
+    static void _accumulate_unpacked(uint32_t val, uint32_t *acc) {
+        for (int k = 0; k < 8; k++) {
+            __m128i unp = _mm_srli_epi32(_bit_mask(val, k), 31);
+            __m128i temp_acc = _mm_loadu_si128((const __m128i*)(acc+4*k));
+            _mm_storeu_si128((__m128i*)(acc+4*k), _mm_add_epi32(temp_acc, unp));
+        }
+    }
+
+    static uint32_t _threshold_pack(const uint32_t *acc, uint32_t threshold) {
+        // There is no unsigned comparison, so both sides are offset by 2^31
+        // and compared as signed numbers
+        const __m128i bias = _mm_set1_epi32(INT32_MIN);
+        __m128i biased_threshold = _mm_xor_si128(_mm_set1_epi32(threshold), bias);
+        uint32_t word = 0;
+
+        for (int k = 0; k < 8; k++) {
+            __m128i temp_acc = _mm_loadu_si128((const __m128i*)(acc+4*k));
+            __m128i res = _mm_cmpgt_epi32(_mm_xor_si128(temp_acc, bias), biased_threshold);
+            // Gather the MSB of each 32-bit lane into a 4-bit mask
+            uint32_t bits = _mm_movemask_ps(_mm_castsi128_ps(res));
+            word |= bits << (4*k);
+        }
+
+        return word;
+    }
+
+    static void _accumulate_weighted(uint32_t val, int32_t weight, int32_t *acc) {
+        __m128i pos = _mm_set1_epi32(weight);
+        __m128i neg = _mm_set1_epi32(-weight);
+
+        for (int k = 0; k < 8; k++) {
+            __m128i temp_w = _mm_blendv_epi8(neg, pos, _bit_mask(val, k));
+            __m128i temp_acc = _mm_loadu_si128((const __m128i*)(acc+4*k));
+            _mm_storeu_si128((__m128i*)(acc+4*k), _mm_add_epi32(temp_acc, temp_w));
+        }
+    }
+
+    static uint32_t _sign_pack(const int32_t *acc) {
+        uint32_t word = 0;
+
+        for (int k = 0; k < 8; k++) {
+            __m128i temp_acc = _mm_loadu_si128((const __m128i*)(acc+4*k));
+            __m128i res = _mm_cmpgt_epi32(temp_acc, _mm_setzero_si128());
+            uint32_t bits = _mm_movemask_ps(_mm_castsi128_ps(res));
+            word |= bits << (4*k);
+        }
+
+        return word;
+    }
+
+    static void _accumulate_weighted_words(
+            const uint32_t *words,
+            std::size_t n,
+            int32_t weight,
+            int32_t *acc
+        ) {
+        for (std::size_t w = 0; w < n; w++) {
+            _accumulate_weighted(words[w], weight, acc+32*w);
+        }
+    }
+
+    static void _sign_pack_words(const int32_t *acc, std::size_t n, uint32_t *out) {
+        for (std::size_t w = 0; w < n; w++) {
+            out[w] = _sign_pack(acc+32*w);
+        }
+    }
+
+    // Bit-sliced majority of four words at once. load4(k, w) returns the
+    // words w to w+3 of the input k.
+    template<typename Load4>
+    static std::size_t _bitsliced_majority(
+            Load4 load4,
+            std::size_t n,
+            std::size_t words,
+            uint32_t threshold,
+            uint32_t *out
+        ) {
+        const std::size_t planes = _planes(n);
+        __m128i count[_MAX_PLANES];
+
+        std::size_t w = 0;
+        for (; w + 4 <= words; w += 4) {
+            for (std::size_t p = 0; p < planes; p++) {
+                count[p] = _mm_setzero_si128();
+            }
+
+            for (std::size_t k = 0; k < n; k++) {
+                __m128i carry = load4(k, w);
+                for (std::size_t p = 0; p < planes && !_mm_testz_si128(carry, carry); p++) {
+                    __m128i next = _mm_and_si128(count[p], carry);
+                    count[p] = _mm_xor_si128(count[p], carry);
+                    carry = next;
+                }
+            }
+
+            __m128i gt = _mm_setzero_si128();
+            __m128i eq = _mm_set1_epi32(-1);
+            for (std::size_t p = planes; p-- > 0;) {
+                if ((threshold >> p) & 1) {
+                    eq = _mm_and_si128(eq, count[p]);
+                }
+                else {
+                    gt = _mm_or_si128(gt, _mm_and_si128(eq, count[p]));
+                    eq = _mm_andnot_si128(count[p], eq);
+                }
+            }
+            _mm_storeu_si128((__m128i*)(out+w), gt);
+        }
+
+        // First word that was not counted
+        return w;
+    }
+
+    static void _xor_majority(
+            const uint32_t *const *a,
+            const uint32_t *const *b,
+            std::size_t n,
+            std::size_t words,
+            uint32_t threshold,
+            uint32_t *out
+        ) {
+        auto load4 = [a, b](std::size_t k, std::size_t w) {
+            return _mm_xor_si128(
+                    _mm_loadu_si128((const __m128i*)(a[k]+w)),
+                    _mm_loadu_si128((const __m128i*)(b[k]+w)));
+        };
+        std::size_t w = _bitsliced_majority(load4, n, words, threshold, out);
+        scalar::xor_majority_range(a, b, n, w, words, threshold, out);
+    }
+
+    static void _majority(
+            const uint32_t *const *a,
+            std::size_t n,
+            std::size_t words,
+            uint32_t threshold,
+            uint32_t *out
+        ) {
+        auto load4 = [a](std::size_t k, std::size_t w) {
+            return _mm_loadu_si128((const __m128i*)(a[k]+w));
+        };
+        std::size_t w = _bitsliced_majority(load4, n, words, threshold, out);
+        scalar::majority_range(a, n, w, words, threshold, out);
+    }
+
+    static uint64_t _hamming(const uint32_t *a, const uint32_t *b, std::size_t words) {
+        uint64_t res = 0;
+        std::size_t w = 0;
+        for (; w + 2 <= words; w += 2) {
+            uint64_t x, y;
+            std::memcpy(&x, a+w, sizeof(x));
+            std::memcpy(&y, b+w, sizeof(y));
+            res += _mm_popcnt_u64(x ^ y);
+        }
+        if (w < words) {
+            res += _mm_popcnt_u32(a[w] ^ b[w]);
+        }
+        return res;
+    }
+
+    const kernels_t kernels = {
+        _unpack,
+        _accumulate_unpacked,
+        _threshold_pack,
+        _accumulate_weighted,
+        _accumulate_weighted_words,
+        _sign_pack,
+        _sign_pack_words,
+        _xor_majority,
+        _majority,
+        _hamming,
+    };
+}
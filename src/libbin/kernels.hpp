@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Kernels of one instruction set. Each set is compiled in its own translation
+// unit with the flags of its ISA, and bitmanip.cpp selects one of them at run
+// time. Code shared by the translation units must have internal linkage, or
+// the linker may pick a copy compiled for an ISA the CPU does not support.
+namespace bitmanip {
+    struct kernels_t {
+        void (*unpack)(uint32_t val, uint32_t *out);
+        void (*accumulate_unpacked)(uint32_t val, uint32_t *acc);
+        uint32_t (*threshold_pack)(const uint32_t *acc, uint32_t threshold);
+        void (*accumulate_weighted)(uint32_t val, int32_t weight, int32_t *acc);
+        void (*accumulate_weighted_words)(
+            const uint32_t *words,
+            std::size_t n,
+            int32_t weight,
+            int32_t *acc);
+        uint32_t (*sign_pack)(const int32_t *acc);
+        void (*sign_pack_words)(const int32_t *acc, std::size_t n, uint32_t *out);
+        void (*xor_majority)(
+            const uint32_t *const *a,
+            const uint32_t *const *b,
+            std::size_t n,
+            std::size_t words,
+            uint32_t threshold,
+            uint32_t *out);
+        void (*majority)(
+            const uint32_t *const *a,
+            std::size_t n,
+            std::size_t words,
+            uint32_t threshold,
+            uint32_t *out);
+        uint64_t (*hamming)(const uint32_t *a, const uint32_t *b, std::size_t words);
+    };
+
+    namespace scalar {
+        extern const kernels_t kernels;
+
+        // Majorities of the words [begin, end), used by the SIMD kernels for
+        // the words that do not fill a register
+        void xor_majority_range(
+            const uint32_t *const *a,
+            const uint32_t *const *b,
+            std::size_t n,
+            std::size_t begin,
+            std::size_t end,
+            uint32_t threshold,
+            uint32_t *out);
+        void majority_range(
+            const uint32_t *const *a,
+            std::size_t n,
+            std::size_t begin,
+            std::size_t end,
+            uint32_t threshold,
+            uint32_t *out);
+    }
+
+    namespace sse42 {
+        extern const kernels_t kernels;
+    }
+
+    namespace avx2 {
+        extern const kernels_t kernels;
+    }
+
+    // Bit-sliced counters. Bit i of plane p holds bit p of the count of lane
+    // i, so adding a word to the count is a ripple-carry addition over the
+    // planes. Lanes whose count is greater than the threshold are found by
+    // comparing the planes against the threshold bits, most significant first.
+    constexpr std::size_t _MAX_PLANES = sizeof(std::size_t) * 8;
+
+    // Planes needed to count up to n
+    static inline std::size_t _planes(std::size_t n) {
+        std::size_t planes = 1;
+        while (planes < _MAX_PLANES && (n >> planes)) {
+            planes++;
+        }
+        return planes;
+    }
+}
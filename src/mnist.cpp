@@ -2,107 +2,81 @@
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
-#include <cstring>
-#include <fstream>
+#include <cstdlib>
 #include <iostream>
+#include <memory_resource>
 #include <stdexcept>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include <argparse/argparse.hpp>
 
+#include "Arena.hpp"
 #include "AssociativeMemory.hpp"
+#include "DatasetView.hpp"
+#include "EncodedDataset.hpp"
 #include "ItemMemory.hpp"
+#include "MappedFile.hpp"
+#include "Matrix.hpp"
+#include "Profiler.hpp"
+#include "TransposedItemMemory.hpp"
 #include "hdc.hpp"
+#include "ThreadPool.hpp"
 #include "common_args.hpp"
 
 // Each image contains 28x28 (784) pixels
 const std::size_t _SIZE_IMG = 784;
 
-typedef std::vector<std::uint8_t> data_t;
-typedef std::vector<data_t> dataset_t;
-typedef std::vector<std::uint8_t> label_t;
-
-dataset_t read_dataset(const std::string& path) {
-    std::ifstream f(path, std::ios::ate | std::ios::binary);
-    if (!f.is_open()) {
-        std::cerr << "Could not open file: " << path << std::endl;
-        assert(f.is_open());
-    }
-
-    dataset_t dataset;
+// Images per chunk of work given to the thread pool
+const std::size_t _GRAIN = 16;
 
-    std::size_t f_size = f.tellg();
-    f.seekg(0, std::ios::beg);
-    std::vector<char> buffer;
-    buffer.resize(f_size);
-    f.read(buffer.data(), f_size);
+// Images are bit masks of the pixels, bit i of the image is bit i%64 of the
+// word i/64
+const std::size_t _MASK_WORDS = hdc::TransposedItemMemory::words(_SIZE_IMG);
 
-    if (!f) {
-        std::cerr << "Failed to read file" << std::endl;
-        assert(false);
-    }
+typedef hdc::Matrix<std::uint64_t> dataset_t;
+typedef std::vector<std::uint8_t> label_t;
 
-    // Make sure the buffer size is multiple of the image size. Buffer size
-    // must be multiple of the number of pixels in the image. Each pixel has 1
-    // byte, and each image is 28x28 (784) pixels.
-    assert((buffer.size() % _SIZE_IMG) == 0);
+dataset_t read_dataset(const std::string& path) {
+    // The pixels are read from a mapping of the file. Each pixel has 1 byte,
+    // and each image is 28x28 (784) pixels.
+    auto images = hdc::DatasetView<std::uint8_t>::open(path, _SIZE_IMG);
 
-    // Convert the pixel values from 0-255 to 0-1
+    // Convert the pixel values from 0-255 to 0-1 and pack them
     const std::uint8_t threshold = 255/2;
-    for (std::size_t i = 0; i < buffer.size(); i++) {
-        buffer[i] = (std::uint8_t)buffer[i] > threshold ? 1 : 0;
-    }
-
-    for (std::size_t i = 0; i < buffer.size(); i += _SIZE_IMG) {
-        data_t img;
-        img.resize(_SIZE_IMG);
-        std::memcpy(img.data(), buffer.data()+i, _SIZE_IMG);
-        dataset.emplace_back(img);
-    }
+    dataset_t dataset(images.size(), _MASK_WORDS, 0);
+    hdc::ThreadPool::global().parallel_for(0, images.size(), [&](std::size_t img) {
+        const std::uint8_t* pixels = images[img];
+        std::uint64_t* mask = dataset.row(img);
+        for (std::size_t i = 0; i < _SIZE_IMG; i++) {
+            std::uint64_t bit = pixels[i] > threshold ? 1 : 0;
+            mask[i / 64] |= bit << (i % 64);
+        }
+    }, _GRAIN);
 
     return dataset;
 }
 
 label_t read_labels(const std::string& path) {
-    std::ifstream f(path, std::ios::ate | std::ios::binary);
-    if (!f.is_open()) {
-        std::cerr << "Could not open file: " << path << std::endl;
-        assert(f.is_open());
-    }
-
-    std::size_t f_size = f.tellg();
-    f.seekg(0, std::ios::beg);
-    std::vector<char> buffer;
-    buffer.resize(f_size);
-    f.read(buffer.data(), f_size);
-
-    if (!f) {
-        std::cerr << "Failed to read file" << std::endl;
-        assert(false);
-    }
-
-    label_t labels;
-    labels.resize(buffer.size());
-
-    std::memcpy(labels.data(), buffer.data(), buffer.size());
-
-    return labels;
+    hdc::MappedFile file(path);
+    return label_t(file.data(), file.data() + file.size());
 }
 
 template<typename VectorType>
 VectorType encode_query(
-        const data_t &pixels,
+        const std::uint64_t *pixels,
         const hdc::ItemMemory<VectorType> &idm
         ) {
-    std::vector<VectorType> vec;
+    // The items are bundled through views, so they are never copied
+    hdc::ScopedArena arena;
+    std::pmr::vector<typename VectorType::rotated_type> vec(arena.resource());
+    vec.reserve(_SIZE_IMG);
 
-    for (std::size_t i = 0; i < pixels.size(); i++) {
-        auto p_vec = idm.at(i);
+    for (std::size_t i = 0; i < _SIZE_IMG; i++) {
         // Bitshift black pixels
-        if (!pixels[i]) {
-            p_vec = hdc::p(p_vec);
-        }
-        vec.emplace_back(p_vec);
+        bool black = !((pixels[i / 64] >> (i % 64)) & 1);
+        vec.emplace_back(idm.at(i), black ? 1 : 0);
     }
 
     return hdc::add(vec);
@@ -110,22 +84,20 @@ VectorType encode_query(
 
 template<typename VectorType>
 float predict(
-        const dataset_t &test_data,
+        const hdc::EncodedDataset<VectorType> &test_data,
         const label_t &labels,
-        const hdc::ItemMemory<VectorType> &idm,
         const hdc::AssociativeMemory<VectorType> &am) {
     assert(labels.size() == test_data.size());
 
-    std::size_t correct = 0;
-
-    for (std::size_t i = 0; i < test_data.size(); i++) {
-        int pred_label = am.search(
-                encode_query(test_data[i], idm)
-                );
-        if (pred_label == labels[i]) {
-            correct++;
-        }
-    }
+    std::size_t correct = hdc::ThreadPool::global().parallel_reduce(
+            0, test_data.size(), _GRAIN, std::size_t(0),
+            [&](std::size_t &correct, std::size_t i) {
+                int pred_label = am.search(test_data.view(i));
+                if (pred_label == labels[i]) {
+                    correct++;
+                }
+            },
+            [](std::size_t &res, std::size_t partial) { res += partial; });
 
     return (float)correct/(float)test_data.size()*100.;
 }
@@ -133,43 +105,44 @@ float predict(
 template<typename VectorType>
 hdc::AssociativeMemory<VectorType> train_am(
         int retrain,
-        const dataset_t &train_dataset,
+        const hdc::EncodedDataset<VectorType> &encoded_train,
         const label_t &train_labels,
-        const dataset_t &test_dataset,
-        const label_t &test_labels,
-        const hdc::ItemMemory<VectorType> &idm
+        const hdc::EncodedDataset<VectorType> &encoded_test,
+        const label_t &test_labels
         ) {
-    if (train_labels.size() != train_dataset.size()) {
+    if (train_labels.size() != encoded_train.size()) {
         throw std::runtime_error("Attempt to train AM using incompatible train and label datasets.");
     }
 
-    std::vector<VectorType> encoded_train; // Container of encoded vectors from the train dataset
-    // Container of vectors belonging to a label (or class)
+    auto &pool = hdc::ThreadPool::global();
+    hdc::ScopedTimer train_timer("train");
+    train_timer.samples(encoded_train.size());
+
+    // Bundle of the vectors belonging to a label (or class)
     int max = *std::max_element(train_labels.begin(), train_labels.end())+1;
-    std::vector<std::vector<VectorType>> class_vectors(max, std::vector<VectorType>());
+    std::vector<hdc::Accumulator<VectorType>> class_vectors(
+            max, hdc::Accumulator<VectorType>(encoded_train.dim()));
 
-    // Encode the train dataset and store each encoded vector in the
-    // class_vectors list
+    // Add each encoded vector to its class in dataset order
     for (std::size_t i = 0; i < train_labels.size(); i++) {
-        encoded_train.emplace_back(encode_query(train_dataset[i], idm)); // Codifica o train dataset
-        class_vectors.at(train_labels[i]).emplace_back(encoded_train[i]); // Cria os class vectors
+        class_vectors.at(train_labels[i]).add(encoded_train.view(i));
     }
 
     // Create AM
     auto am = hdc::AssociativeMemory<VectorType>();
     for (auto &i : class_vectors) {
-        VectorType acc = hdc::add(i);
-        am.emplace_back(acc);
+        am.emplace_back(i.result());
     }
+    train_timer.stop();
 
     // Retraining
+    hdc::ScopedTimer retrain_timer("retrain");
     for (int times = 0; times < retrain; times++) {
         // Recreate AM only if it is not the first training time
         if (times > 0) {
             am.clear();
             for (auto &i : class_vectors) {
-                VectorType acc = hdc::add(i);
-                am.emplace_back(acc);
+                am.emplace_back(i.result());
             }
         }
 
@@ -179,28 +152,34 @@ hdc::AssociativeMemory<VectorType> train_am(
             float train_acc = -1.0;
             std::size_t correct = 0;
 
+            // The AM does not change during an iteration, so all predictions
+            // are computed in parallel first
+            std::vector<int> predictions(encoded_train.size());
+            pool.parallel_for(0, encoded_train.size(), [&](std::size_t i) {
+                predictions[i] = am.search(encoded_train.view(i));
+            }, _GRAIN);
+
             // Retrain the class vectors while predicting on the train dataset
-            for (std::size_t i = 0; i < train_dataset.size(); i++) {
-                const VectorType &query = encoded_train[i];
-                int pred_label = am.search(query);
+            for (std::size_t i = 0; i < encoded_train.size(); i++) {
+                auto query = encoded_train.view(i);
+                int pred_label = predictions[i];
                 if (pred_label != train_labels[i]) {
-                    class_vectors[train_labels[i]].emplace_back(query);
-                    auto inverted_query = query;
-                    inverted_query.invert();
-                    class_vectors[pred_label].emplace_back(inverted_query);
+                    class_vectors[train_labels[i]].add(query);
+                    class_vectors[pred_label].subtract(query);
                 }
                 else {
                     correct++;
                 }
             }
 
-            train_acc = (float)correct/(float)train_dataset.size() * 100.;
+            train_acc = (float)correct/(float)encoded_train.size() * 100.;
+            retrain_timer.samples(encoded_train.size());
+            retrain_timer.searches(encoded_train.size() + encoded_test.size());
 
             // Test accuracy on the test dataset
             float test_acc = predict(
-                    test_dataset,
+                    encoded_test,
                     test_labels,
-                    idm,
                     am);
 
             std::cout << "Iteration: " << times <<
@@ -213,6 +192,52 @@ hdc::AssociativeMemory<VectorType> train_am(
     return am;
 }
 
+// Key of the encoded dataset cache
+std::string cache_key(const argparse::ArgumentParser& args, const std::string& name) {
+    return "mnist " + args.get("hdc") +
+        " D=" + std::to_string(args.get<size_t>("--dim")) +
+        " seed=" + std::to_string(args.get<unsigned int>("--seed")) +
+        " data=" + hdc::file_signature(args.get(name + "_data"));
+}
+
+std::string cache_dir(const argparse::ArgumentParser& args) {
+    return args.is_used("--cache-dir") ? args.get("--cache-dir") : "";
+}
+
+// Encode a dataset, or map it from the cache when --cache-dir is given and
+// it was encoded before with the same parameters
+template<typename VectorType>
+hdc::EncodedDataset<VectorType> encode_dataset(
+        const argparse::ArgumentParser& args,
+        const std::string& name,
+        const dataset_t &dataset,
+        const hdc::ItemMemory<VectorType> &idm
+        ) {
+    return hdc::EncodedDataset<VectorType>::cached(
+            cache_dir(args), name, cache_key(args, name),
+            dataset.rows(), idm.at(0).size(),
+            [&](std::size_t i) { return encode_query(dataset.row(i), idm); },
+            _GRAIN);
+}
+
+// Binary images bundle the IM items selected by the pixel mask, which is
+// computed with popcounts over the transposed IM
+hdc::EncodedDataset<hdc::bin_t> encode_dataset(
+        const argparse::ArgumentParser& args,
+        const std::string& name,
+        const dataset_t &dataset,
+        const hdc::ItemMemory<hdc::bin_t> &idm
+        ) {
+    hdc::TransposedItemMemory transposed(idm);
+    return hdc::EncodedDataset<hdc::bin_t>::cached(
+            cache_dir(args), name, cache_key(args, name),
+            dataset.rows(), idm.at(0).size(),
+            [&](std::size_t i) {
+                return transposed.encode(dataset.row(i));
+            },
+            _GRAIN);
+}
+
 template<typename VectorType>
 int mnist(const argparse::ArgumentParser& args) {
     int retrain = args.get<size_t>("--retrain");
@@ -221,23 +246,41 @@ int mnist(const argparse::ArgumentParser& args) {
     std::cout << "retrain: " << retrain <<
         " D: " << dim << std::endl;
 
+    hdc::ScopedTimer read_timer("read");
     auto train_dataset = read_dataset(args.get("train_data"));
     auto train_labels = read_labels(args.get("train_labels"));
     auto test_dataset = read_dataset(args.get("test_data"));
     auto test_labels = read_labels(args.get("test_labels"));
+    read_timer.samples(train_dataset.rows() + test_dataset.rows());
+    read_timer.stop();
 
+    hdc::ScopedTimer memories_timer("memories");
     hdc::ItemMemory<VectorType> idm(_SIZE_IMG, dim); // ID memory
+    memories_timer.stop();
     //std::vector<hdc::HDV> am; // Associative memory
 
+    // Both datasets are encoded once and reused by every iteration
+    hdc::ScopedTimer encode_timer("encode");
+    auto encoded_train = encode_dataset(args, "train", train_dataset, idm);
+    auto encoded_test = encode_dataset(args, "test", test_dataset, idm);
+    for (const auto *encoded : {&encoded_train, &encoded_test}) {
+        encode_timer.samples(encoded->size());
+        encode_timer.encodes(encoded->mapped() ? 0 : encoded->size());
+    }
+    encode_timer.stop();
+
     auto am = train_am(
             retrain,
-            train_dataset,
+            encoded_train,
             train_labels,
-            test_dataset,
-            test_labels,
-            idm);
-
-    float accuracy = predict(test_dataset, test_labels, idm, am);
+            encoded_test,
+            test_labels);
+
+    hdc::ScopedTimer test_timer("test");
+    float accuracy = predict(encoded_test, test_labels, am);
+    test_timer.samples(encoded_test.size());
+    test_timer.searches(encoded_test.size());
+    test_timer.stop();
     std::cout << "Final accuracy: " << accuracy << "%" << std::endl;
 
     return 0;
@@ -255,6 +298,10 @@ auto add_args(argparse::ArgumentParser& program) {
 
     // Optional arguments
     common_args::add_args(program);
+    program.add_argument("--cache-dir")
+        .help("Directory where the encoded datasets are stored. Later runs "
+              "with the same data, seed, type and dimension map them instead "
+              "of encoding the datasets again.");
 
     //program.add_argument("--load-model")
     //    .help("Load model from path and only execute the test stage. The path "
@@ -275,12 +322,18 @@ int main(int argc, char *argv[]) {
     try {
         add_args(args);
         args.parse_args(argc, argv);
+        bitmanip::set_isa(args.get("--isa"));
+        common_args::check_profile(args);
     } catch (const std::runtime_error& e) {
         std::cout << args << std::endl;
         std::cerr << "Failed to parse arguments! " << e.what() << std::endl;
         return -1;
     }
 
+    hdc::ThreadPool::set_threads(args.get<size_t>("--threads"));
+    std::srand(args.get<unsigned int>("--seed"));
+    common_args::ProfileReport profile(args, "mnist");
+
     auto hdc = args.get("hdc");
 
     if (hdc == "bin") {
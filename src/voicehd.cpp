@@ -1,125 +1,82 @@
 #include <cassert>
 #include <cstddef>
-#include <fstream>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
-#include <sstream>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 #include <argparse/argparse.hpp>
 
 #include "AssociativeMemory.hpp"
+#include "BindingTable.hpp"
 #include "ContinuousItemMemory.hpp"
+#include "CsvReader.hpp"
+#include "EncodedDataset.hpp"
 #include "ItemMemory.hpp"
+#include "Matrix.hpp"
+#include "Profiler.hpp"
+#include "Quantizer.hpp"
+#include "RecordEncoder.hpp"
+#include "ThreadPool.hpp"
 #include "common_args.hpp"
 #include "types.hpp"
 #include "hdc.hpp"
 
-typedef std::vector<float> data_t;
-typedef std::vector<data_t> dataset_t;
+typedef hdc::Matrix<float> dataset_t;
+// Level of every value of a dataset
+typedef hdc::Matrix<std::uint32_t> quantized_t;
 typedef std::vector<int> label_t;
 
-dataset_t read_dataset(const std::string& path) {
-    std::ifstream f(path);
-    if (!f.is_open()) {
-        std::cerr << "Could not open file: " << path << std::endl;
-        assert(f.is_open());
-    }
+// Samples per chunk of work given to the thread pool
+const std::size_t _GRAIN = 16;
 
-    dataset_t dataset;
-    std::string line;
-    while (std::getline(f, line)) {
-        float i;
-        data_t data;
-        std::stringstream ss(line);
-        while (ss >> i) {
-            data.emplace_back(i);
-            if (ss.peek() == ',') {
-                ss.ignore();
-            }
-        }
-        dataset.emplace_back(data);
-    }
-
-    return dataset;
+dataset_t read_dataset(const std::string& path) {
+    return hdc::read_csv<float>(path);
 }
 
 label_t read_labels(const std::string& path) {
-    std::ifstream f(path);
-    if (!f.is_open()) {
-        std::cerr << "Could not open file: " << path << std::endl;
-        assert(f.is_open());
-    }
-
-    label_t labels;
-    std::string line;
-    while (std::getline(f, line)) {
-        labels.emplace_back(std::stoi(line));
-    }
-
-    return labels;
-}
-
-int get_amplitude_bin(float amp, std::size_t levels) {
-    // Values defined by the dataset
-    const float min = -1.0;
-    const float max =  1.0;
-
-    assert(amp >= min);
-    assert(amp <= max);
-
-    float range = 2.0;
-    float step = range / levels;
-
-    for (int i = 0; i <= levels; i++) {
-        float top_threshold = min+(step*(i+1));
-        if (amp <= top_threshold) {
-            return i;
-        }
+    auto labels = hdc::read_csv<int>(path);
+    if (labels.cols() > 1) {
+        throw std::runtime_error("Expected a single label per line in " + path);
     }
-
-    assert(false);
+    return label_t(labels.begin(), labels.end());
 }
 
 template<typename VectorType>
 VectorType encode_query(
-        const data_t &amplitudes,
+        const std::uint32_t *amp_bins,
+        std::size_t size,
         const hdc::ItemMemory<VectorType> &idm,
-        const hdc::ContinuousItemMemory<VectorType> &cim
+        const hdc::ContinuousItemMemory<VectorType> &cim,
+        const hdc::BindingTable<VectorType> *table
         ) {
-    int levels = cim.size();
-    std::vector<VectorType> vec;
-
-    for (std::size_t i = 0; i < amplitudes.size(); i++) {
-        float amp = amplitudes[i];
-        int amp_bin = get_amplitude_bin(amp, levels);
-        auto temp = hdc::mul(idm.at(i), cim.at(amp_bin));
-        vec.emplace_back(temp);
+    if (table) {
+        return table->encode(amp_bins, size);
     }
-
-    return hdc::add(vec);
+    return hdc::encode_record(idm, cim, amp_bins, size);
 }
 
 template<typename VectorType>
 float predict(
-        const dataset_t &test_data,
+        const hdc::EncodedDataset<VectorType> &test_data,
         const label_t &labels,
-        const hdc::ItemMemory<VectorType> &idm,
-        const hdc::ContinuousItemMemory<VectorType> &cim,
         const hdc::AssociativeMemory<VectorType> &am) {
     assert(labels.size() == test_data.size());
 
-    std::size_t correct = 0;
-
-    for (std::size_t i = 0; i < test_data.size(); i++) {
-        auto query = encode_query(test_data[i], idm, cim);
-        int pred_label = am.search(query);
-        if (pred_label == labels[i]) {
-            correct++;
-        }
-    }
+    std::size_t correct = hdc::ThreadPool::global().parallel_reduce(
+            0, test_data.size(), _GRAIN, std::size_t(0),
+            [&](std::size_t &correct, std::size_t i) {
+                int pred_label = am.search(test_data.view(i));
+                if (pred_label == labels[i]) {
+                    correct++;
+                }
+            },
+            [](std::size_t &res, std::size_t partial) { res += partial; });
 
     return (float)correct/(float)test_data.size()*100.;
 }
@@ -127,42 +84,42 @@ float predict(
 template<typename VectorType>
 hdc::AssociativeMemory<VectorType> train_am(
         std::size_t retrain,
-        const dataset_t &train_dataset,
+        const hdc::EncodedDataset<VectorType> &encoded_train,
         const label_t &train_labels,
-        const dataset_t &test_dataset,
-        const label_t &test_labels,
-        const hdc::ItemMemory<VectorType> &idm,
-        const hdc::ContinuousItemMemory<VectorType> &cim
+        const hdc::EncodedDataset<VectorType> &encoded_test,
+        const label_t &test_labels
         ) {
-    assert(train_labels.size() == train_dataset.size());
+    assert(train_labels.size() == encoded_train.size());
 
-    std::vector<VectorType> encoded_train; // Container of encoded vectors from the train dataset
-    // Container of vectors belonging to a label (or class)
+    auto &pool = hdc::ThreadPool::global();
+    hdc::ScopedTimer train_timer("train");
+    train_timer.samples(encoded_train.size());
+
+    // Bundle of the vectors belonging to a label (or class)
     int max = *std::max_element(train_labels.begin(), train_labels.end())+1;
-    std::vector<std::vector<VectorType>> class_vectors(max, std::vector<VectorType>());
+    std::vector<hdc::Accumulator<VectorType>> class_vectors(
+            max, hdc::Accumulator<VectorType>(encoded_train.dim()));
 
-    // Encode the train dataset and store each encoded vector in the
-    // class_vectors list
+    // Add each encoded vector to its class in dataset order
     for (std::size_t i = 0; i < train_labels.size(); i++) {
-        encoded_train.emplace_back(encode_query(train_dataset[i], idm, cim)); // Codifica o train dataset
-        class_vectors.at(train_labels[i]).emplace_back(encoded_train[i]); // Cria os class vectors
+        class_vectors.at(train_labels[i]).add(encoded_train.view(i));
     }
 
     // Create AM
     auto am = hdc::AssociativeMemory<VectorType>();
     for (auto &i : class_vectors) {
-        VectorType acc = hdc::add(i);
-        am.emplace_back(acc);
+        am.emplace_back(i.result());
     }
+    train_timer.stop();
 
     // Retraining
+    hdc::ScopedTimer retrain_timer("retrain");
     for (int times = 0; times < retrain; times++) {
         // Recreate AM only if it is not the first training time
         if (times > 0) {
             am.clear();
             for (auto &i : class_vectors) {
-                VectorType acc = hdc::add(i);
-                am.emplace_back(acc);
+                am.emplace_back(i.result());
             }
         }
 
@@ -172,29 +129,34 @@ hdc::AssociativeMemory<VectorType> train_am(
             float train_acc = -1.0;
             std::size_t correct = 0;
 
+            // The AM does not change during an iteration, so all predictions
+            // are computed in parallel first
+            std::vector<int> predictions(encoded_train.size());
+            pool.parallel_for(0, encoded_train.size(), [&](std::size_t i) {
+                predictions[i] = am.search(encoded_train.view(i));
+            }, _GRAIN);
+
             // Retrain the class vectors while predicting on the train dataset
-            for (std::size_t i = 0; i < train_dataset.size(); i++) {
-                const VectorType &query = encoded_train[i];
-                int pred_label = am.search(query);
+            for (std::size_t i = 0; i < encoded_train.size(); i++) {
+                auto query = encoded_train.view(i);
+                int pred_label = predictions[i];
                 if (pred_label != train_labels[i]) {
-                    class_vectors[train_labels[i]].emplace_back(query);
-                    auto inverted_query = query;
-                    inverted_query.invert();
-                    class_vectors[pred_label].emplace_back(inverted_query);
+                    class_vectors[train_labels[i]].add(query);
+                    class_vectors[pred_label].subtract(query);
                 }
                 else {
                     correct++;
                 }
             }
 
-            train_acc = (float)correct/(float)train_dataset.size() * 100.;
+            train_acc = (float)correct/(float)encoded_train.size() * 100.;
+            retrain_timer.samples(encoded_train.size());
+            retrain_timer.searches(encoded_train.size() + encoded_test.size());
 
             // Test accuracy on the test dataset
             float test_acc = predict(
-                    test_dataset,
+                    encoded_test,
                     test_labels,
-                    idm,
-                    cim,
                     am);
 
             std::cout << "Iteration: " << times <<
@@ -207,6 +169,43 @@ hdc::AssociativeMemory<VectorType> train_am(
     return am;
 }
 
+// Encode a dataset, or map it from the cache when --cache-dir is given and
+// it was encoded before with the same parameters. Memories loaded with
+// --load-model are not described by the key, so they are never cached.
+template<typename VectorType>
+hdc::EncodedDataset<VectorType> encode_dataset(
+        const argparse::ArgumentParser& args,
+        const std::string& name,
+        const quantized_t &dataset,
+        const hdc::Quantizer &quantizer,
+        const hdc::ItemMemory<VectorType> &idm,
+        const hdc::ContinuousItemMemory<VectorType> &cim,
+        const hdc::BindingTable<VectorType> *table
+        ) {
+    std::string dir;
+    if (args.is_used("--cache-dir") && !args.is_used("--load-model")) {
+        dir = args.get("--cache-dir");
+    }
+
+    std::string key = "voicehd " + args.get("hdc") +
+        " D=" + std::to_string(args.get<size_t>("--dim")) +
+        " levels=" + std::to_string(quantizer.levels()) +
+        " range=" + std::to_string(quantizer.min()) + "," + std::to_string(quantizer.max()) +
+        " seed=" + std::to_string(args.get<unsigned int>("--seed")) +
+        " data=" + hdc::file_signature(args.get(name + "_data"));
+
+    hdc::ScopedTimer timer("encode");
+    auto encoded = hdc::EncodedDataset<VectorType>::cached(
+            dir, name, key, dataset.rows(), idm.at(0).size(),
+            [&](std::size_t i) {
+                return encode_query(dataset.row(i), dataset.cols(), idm, cim, table);
+            },
+            _GRAIN);
+    timer.samples(encoded.size());
+    timer.encodes(encoded.mapped() ? 0 : encoded.size());
+    return encoded;
+}
+
 template <typename VectorType>
 void save_model(const argparse::ArgumentParser &args,
                 const hdc::ItemMemory<VectorType> &idm,
@@ -243,6 +242,7 @@ int voicehd(const argparse::ArgumentParser& args) {
         " levels: " << levels <<
         " D: " << dim << std::endl;
 
+    hdc::ScopedTimer read_timer("read");
     dataset_t train_dataset;
     label_t train_labels;
     if (!args.is_used("--load-model")) {
@@ -251,31 +251,56 @@ int voicehd(const argparse::ArgumentParser& args) {
     }
     auto test_dataset = read_dataset(args.get("test_data"));
     auto test_labels = read_labels(args.get("test_labels"));
+    read_timer.samples(train_dataset.rows() + test_dataset.rows());
+    read_timer.stop();
+
+    // Values defined by the dataset, unless learned from the train data
+    hdc::Quantizer quantizer(-1.0, 1.0, levels);
+    if (args.get<bool>("--fit-range")) {
+        if (args.is_used("--load-model")) {
+            throw std::runtime_error("--fit-range requires the train data.");
+        }
+        quantizer = hdc::Quantizer::fit(train_dataset, levels);
+    }
+    hdc::ScopedTimer quantize_timer("quantize");
+    quantized_t train_levels = quantizer.quantize(train_dataset);
+    quantized_t test_levels = quantizer.quantize(test_dataset);
+    quantize_timer.samples(train_dataset.rows() + test_dataset.rows());
+    quantize_timer.stop();
 
+    hdc::ScopedTimer memories_timer("memories");
     auto idm = hdc::ItemMemory<VectorType>(617, dim);
     auto cim = hdc::ContinuousItemMemory<VectorType>(levels, dim);
 
     hdc::AssociativeMemory<VectorType> am;
+    if (args.is_used("--load-model")) {
+        auto ret = load_model<VectorType>(args);
+        idm = std::get<0>(ret);
+        cim = std::get<1>(ret);
+        am  = std::get<2>(ret);
+    }
+
+    // Both datasets are encoded once and reused by every iteration
+    auto table = common_args::make_binding_table(args, idm, cim, "feature ID");
+    memories_timer.stop();
+    auto encoded_test = encode_dataset(args, "test", test_levels, quantizer, idm, cim, table.get());
     if (!args.is_used("--load-model")) {
+        auto encoded_train = encode_dataset(args, "train", train_levels, quantizer, idm, cim, table.get());
         am = train_am(retrain,
-                train_dataset,
+                encoded_train,
                 train_labels,
-                test_dataset,
-                test_labels,
-                idm,
-                cim);
+                encoded_test,
+                test_labels);
         if (args.is_used("--save-model")) {
             save_model(args, idm, cim, am);
         }
     }
-    else {
-        auto ret = load_model<VectorType>(args);
-        idm = std::get<0>(ret);
-        cim = std::get<1>(ret);
-        am  = std::get<2>(ret);
-    }
 
-    float accuracy = predict(test_dataset, test_labels, idm, cim, am);
+    hdc::ScopedTimer test_timer("test");
+    float accuracy = predict(encoded_test, test_labels, am);
+    test_timer.samples(encoded_test.size());
+    test_timer.searches(encoded_test.size());
+    test_timer.stop();
     std::cout << "Accuracy: " << accuracy << "%" << std::endl;
 
     return 0;
@@ -298,6 +323,19 @@ auto add_args(argparse::ArgumentParser& program) {
         .scan<'d', size_t>()
         .default_value<size_t>(10);
 
+    program.add_argument("--fit-range")
+        .help("Quantize values over the range found in the train data instead "
+              "of the [-1, 1] range of the dataset.")
+        .default_value(false)
+        .implicit_value(true);
+
+    common_args::add_binding_args(program, "feature ID");
+
+    program.add_argument("--cache-dir")
+        .help("Directory where the encoded datasets are stored. Later runs "
+              "with the same data, seed, type, dimension and levels map them "
+              "instead of encoding the datasets again.");
+
     program.add_argument("--load-model")
         .help("Load model from path and only execute the test stage. The path "
               "given must be of a directory containing the data for the IM, "
@@ -317,12 +355,18 @@ int main(int argc, char *argv[]) {
     try {
         add_args(args);
         args.parse_args(argc, argv);
+        bitmanip::set_isa(args.get("--isa"));
+        common_args::check_profile(args);
     } catch (const std::runtime_error& e) {
         std::cout << args << std::endl;
         std::cerr << "Failed to parse arguments! " << e.what() << std::endl;
         return -1;
     }
 
+    hdc::ThreadPool::set_threads(args.get<size_t>("--threads"));
+    std::srand(args.get<unsigned int>("--seed"));
+    common_args::ProfileReport profile(args, "voicehd");
+
     std::string&& hdc = args.get("hdc");
 
     if (hdc == "bin") {
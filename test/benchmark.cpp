@@ -1,15 +1,398 @@
-#include <catch2/catch_all.hpp>
+/*
+ * Microbenchmarks of the libhdc primitives.
+ *
+ * Every benchmark runs an operation until it takes at least --min-time
+ * seconds and reports the time per operation, the operations per second and
+ * the memory throughput in GB/s. The throughput counts the bytes of the
+ * vectors read and written by one operation.
+ *
+ * Results can be written to a JSON file with --json and a file written that
+ * way can be given back with --baseline to flag regressions.
+ */
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <argparse/argparse.hpp>
+
+#include "BindingTable.hpp"
+#include "RecordEncoder.hpp"
 #include "hdc.hpp"
+#include "libbin/bitmanip.hpp"
+
+struct result_t {
+    std::string name;
+    double ns_per_op;
+    double ops_per_s;
+    double gb_per_s;
+};
+
+// Keep the compiler from optimizing away the result of an operation
+template<typename T>
+static void _keep(const T& value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+// Bytes of the entries of a vector
+template<typename T>
+static double _bytes(const T& v) {
+    return std::distance(v.cbegin(), v.cend()) * sizeof(*v.cbegin());
+}
+
+class Suite
+{
+public:
+    Suite(const std::string& filter, double min_time)
+        : _filter(filter), _min_time(min_time) {}
+
+    /**
+     * @brief Time op() if "name" matches the filter.
+     *
+     * @param bytes: Bytes read and written by one call of op().
+     */
+    template<typename Op>
+    void run(const std::string& name, double bytes, Op op) {
+        if (name.find(this->_filter) == std::string::npos) {
+            return;
+        }
+
+        using clock = std::chrono::steady_clock;
+        op();
+
+        // Grow the number of iterations until the run is long enough
+        std::size_t iterations = 1;
+        double elapsed;
+        while (true) {
+            auto start = clock::now();
+            for (std::size_t i = 0; i < iterations; i++) {
+                op();
+            }
+            elapsed = std::chrono::duration<double>(clock::now() - start).count();
+            if (elapsed >= this->_min_time) {
+                break;
+            }
+            double scale = elapsed > 0 ? 1.2 * this->_min_time / elapsed : 10.0;
+            iterations = std::max(iterations * 2, (std::size_t)(iterations * scale));
+        }
+
+        double seconds = elapsed / iterations;
+        result_t res = {name, seconds * 1e9, 1.0 / seconds, bytes / seconds / 1e9};
+        std::cout << std::left << std::setw(48) << name << std::right
+            << std::setw(14) << std::fixed << std::setprecision(1) << res.ns_per_op << " ns"
+            << std::setw(16) << std::setprecision(0) << res.ops_per_s << " ops/s"
+            << std::setw(10) << std::setprecision(2) << res.gb_per_s << " GB/s"
+            << std::endl;
+        this->_results.emplace_back(res);
+    }
+
+    const std::vector<result_t>& results() const { return this->_results; }
+
+private:
+    std::string _filter;
+    double _min_time;
+    std::vector<result_t> _results;
+};
+
+template<typename T>
+static void _benchmark_vectors(
+        Suite& suite,
+        const std::string& type,
+        hdc::dim_t dim,
+        const std::vector<std::size_t>& counts
+        ) {
+    const std::string prefix = type + "/D=" + std::to_string(dim) + "/";
+    const std::size_t classes = 26;
+    std::size_t items = std::max<std::size_t>(
+            classes + 1, *std::max_element(counts.begin(), counts.end()));
+    auto im = hdc::ItemMemory<T>(items, dim);
+    const T& a = im[0];
+    const T& b = im[1];
+    const T& c = im[2];
+    const double bytes = _bytes(a);
+
+    suite.run(prefix + "bind", 3 * bytes, [&]() {
+        _keep(hdc::mul(a, b));
+    });
+    suite.run(prefix + "bundle/n=3", 4 * bytes, [&]() {
+        _keep(hdc::add(a, b, c));
+    });
+    for (auto n : counts) {
+        std::vector<T> vectors;
+        for (std::size_t i = 0; i < n; i++) {
+            vectors.emplace_back(im[i]);
+        }
+        suite.run(prefix + "bundle/n=" + std::to_string(n), (n + 1) * bytes, [&]() {
+            _keep(hdc::add(vectors));
+        });
+    }
+    suite.run(prefix + "permute", 2 * bytes, [&]() {
+        _keep(hdc::p(a, 1));
+    });
+    suite.run(prefix + "permute+bind", 3 * bytes, [&]() {
+        _keep(hdc::mul(a, hdc::p(b, 1)));
+    });
+    suite.run(prefix + "permute+bind/view", 3 * bytes, [&]() {
+        T res(a);
+        res.mul(hdc::p_view(b, 1));
+        _keep(res);
+    });
+    hdc::Accumulator<T> acc(dim);
+    suite.run(prefix + "accumulate/add+subtract", 3 * bytes, [&]() {
+        acc.add(a);
+        acc.subtract(b);
+    });
+    _keep(acc.result());
+    const bool binary = std::is_same_v<T, hdc::bin_t>;
+    suite.run(prefix + (binary ? "hamming" : "cosine"), 2 * bytes, [&]() {
+        _keep(a.dist(b));
+    });
+
+    std::vector<T> entries;
+    for (std::size_t i = 0; i < classes; i++) {
+        entries.emplace_back(im[i+1]);
+    }
+    hdc::AssociativeMemory<T> am(entries);
+    suite.run(prefix + "am_search/classes=26", (classes + 1) * bytes, [&]() {
+        _keep(am.search(a));
+    });
+
+    const std::size_t im_items = 64;
+    suite.run(prefix + "im/items=64", im_items * bytes, [&]() {
+        _keep(hdc::ItemMemory<T>(im_items, dim));
+    });
+    const std::size_t levels = 10;
+    suite.run(prefix + "cim/levels=10", levels * bytes, [&]() {
+        _keep(hdc::ContinuousItemMemory<T>(levels, dim));
+    });
+
+    auto path = std::filesystem::temp_directory_path() / ("hdc_benchmark_" + type + ".txt");
+    suite.run(prefix + "am_save/classes=26", classes * bytes, [&]() {
+        am.save(path.string());
+    });
+    am.save(path.string());
+    suite.run(prefix + "am_load/classes=26", classes * bytes, [&]() {
+        _keep(hdc::AssociativeMemory<T>(path.string()));
+    });
+    std::filesystem::remove(path);
+
+    // Record of the shape of a voicehd sample
+    const std::size_t features = 617;
+    auto ids = hdc::ItemMemory<T>(features, dim);
+    auto cim = hdc::ContinuousItemMemory<T>(levels, dim);
+    std::vector<std::uint32_t> values;
+    for (std::size_t i = 0; i < features; i++) {
+        values.emplace_back(rand() % levels);
+    }
+    suite.run(prefix + "record/features=617", (2 * features + 1) * bytes, [&]() {
+        _keep(hdc::encode_record(ids, cim, values.data(), values.size()));
+    });
+    if (hdc::BindingTable<T>::footprint(features, levels, dim) <= (512u << 20)) {
+        auto table = hdc::BindingTable<T>(ids, cim);
+        suite.run(prefix + "record_table/features=617", (features + 1) * bytes, [&]() {
+            _keep(table.encode(values.data(), values.size()));
+        });
+    }
+}
+
+static void _benchmark_libbin(Suite& suite, std::size_t words) {
+    const std::string prefix = "libbin/words=" + std::to_string(words) + "/";
+    const double bytes = words * sizeof(std::uint32_t);
+    std::vector<std::uint32_t> data(words);
+    std::generate(data.begin(), data.end(), rand);
+
+    suite.run(prefix + "unpack", bytes * 33, [&]() {
+        for (auto w : data) {
+            _keep(bitmanip::unpack(w));
+        }
+    });
+
+    std::vector<std::array<std::uint32_t, 32>> acc(words);
+    for (auto& a : acc) {
+        std::generate(a.begin(), a.end(), []() { return rand() % 64; });
+    }
+    suite.run(prefix + "threshold_pack", bytes * 33, [&]() {
+        for (const auto& a : acc) {
+            _keep(bitmanip::threshold_pack(a, 32));
+        }
+    });
+
+    std::array<std::uint32_t, 32> counters = {};
+    suite.run(prefix + "accumulate_unpacked", bytes, [&]() {
+        for (auto w : data) {
+            bitmanip::accumulate_unpacked(w, counters);
+        }
+        _keep(counters);
+    });
+
+    // Majority of as many inputs as features in a voicehd sample
+    const std::size_t n = 617;
+    std::vector<std::vector<std::uint32_t>> inputs(n, std::vector<std::uint32_t>(words));
+    std::vector<const std::uint32_t*> rows;
+    for (auto& v : inputs) {
+        std::generate(v.begin(), v.end(), rand);
+        rows.emplace_back(v.data());
+    }
+    std::vector<const std::uint32_t*> others(rows.rbegin(), rows.rend());
+    std::vector<std::uint32_t> out(words);
+    suite.run(prefix + "majority/n=617", (n + 1) * bytes, [&]() {
+        bitmanip::majority(rows.data(), n, words, n / 2, out.data());
+        _keep(out);
+    });
+    suite.run(prefix + "xor_majority/n=617", (2 * n + 1) * bytes, [&]() {
+        bitmanip::xor_majority(rows.data(), others.data(), n, words, n / 2, out.data());
+        _keep(out);
+    });
+}
+
+static std::vector<std::size_t> _parse_list(const std::string& str) {
+    std::vector<std::size_t> values;
+    std::stringstream ss(str);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        values.emplace_back(std::stoul(item));
+    }
+    if (values.empty()) {
+        throw std::runtime_error("Empty list: " + str);
+    }
+    return values;
+}
+
+// One benchmark per line, so that baselines can be read line by line
+static void _write_json(const std::string& path, const std::vector<result_t>& results) {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        throw std::runtime_error("Error when opening file: " + path);
+    }
+
+    out << "{\n  \"benchmarks\": [\n" << std::setprecision(6);
+    for (std::size_t i = 0; i < results.size(); i++) {
+        const auto& r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"ns_per_op\": " << r.ns_per_op
+            << ", \"ops_per_s\": " << r.ops_per_s << ", \"gb_per_s\": " << r.gb_per_s
+            << "}" << (i+1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+static std::map<std::string, double> _read_baseline(const std::string& path) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        throw std::runtime_error("Error when opening file: " + path);
+    }
+
+    const std::regex entry("\"name\": \"([^\"]+)\", \"ns_per_op\": ([^,]+),");
+    std::map<std::string, double> baseline;
+    std::string line;
+    std::smatch match;
+    while (std::getline(in, line)) {
+        if (std::regex_search(line, match, entry)) {
+            baseline[match[1]] = std::stod(match[2]);
+        }
+    }
+    return baseline;
+}
+
+// Print the change of every benchmark and count those slower than tolerance
+static int _compare(
+        const std::vector<result_t>& results,
+        const std::map<std::string, double>& baseline,
+        double tolerance
+        ) {
+    int regressions = 0;
+    std::cout << "\nComparison with the baseline" << std::endl;
+    for (const auto& r : results) {
+        auto it = baseline.find(r.name);
+        if (it == baseline.end()) {
+            continue;
+        }
+        double change = (r.ns_per_op / it->second - 1.0) * 100.0;
+        bool regression = change > tolerance;
+        regressions += regression;
+        std::cout << std::left << std::setw(48) << r.name << std::right
+            << std::setw(10) << std::fixed << std::setprecision(1) << std::showpos
+            << change << "%" << std::noshowpos
+            << (regression ? "  REGRESSION" : "") << std::endl;
+    }
+    return regressions;
+}
+
+int main(int argc, char *argv[]) {
+    argparse::ArgumentParser args("benchmark");
+    args.add_argument("--filter")
+        .help("Only run the benchmarks whose name contains this string.")
+        .default_value(std::string(""));
+    args.add_argument("--dims")
+        .help("Comma separated list of dimensions.")
+        .default_value(std::string("1000,10000"));
+    args.add_argument("--counts")
+        .help("Comma separated list of vector counts of the N-input bundle.")
+        .default_value(std::string("16,128,1024"));
+    args.add_argument("--min-time")
+        .help("Minimum seconds each benchmark runs for.")
+        .scan<'g', double>()
+        .default_value<double>(0.2);
+    args.add_argument("--json")
+        .help("Write the results to this JSON file.");
+    args.add_argument("--baseline")
+        .help("JSON file of a previous run. Benchmarks slower than the "
+              "tolerance are reported and make the program fail.");
+    args.add_argument("--tolerance")
+        .help("Slowdown in percent over the baseline reported as a "
+              "regression.")
+        .scan<'g', double>()
+        .default_value<double>(10.0);
+    args.add_argument("--isa")
+        .help("Instruction set of the libbin kernels: auto, scalar, sse4.2 "
+              "or avx2.")
+        .default_value(std::string("auto"));
+
+    try {
+        args.parse_args(argc, argv);
+        bitmanip::set_isa(args.get("--isa"));
+    } catch (const std::runtime_error& e) {
+        std::cout << args << std::endl;
+        std::cerr << "Failed to parse arguments! " << e.what() << std::endl;
+        return -1;
+    }
+
+    std::cout << "libbin kernels: " << bitmanip::isa_name(bitmanip::isa()) << std::endl;
+
+    auto dims = _parse_list(args.get("--dims"));
+    auto counts = _parse_list(args.get("--counts"));
+    Suite suite(args.get("--filter"), args.get<double>("--min-time"));
+
+    for (auto dim : dims) {
+        _benchmark_vectors<hdc::bin_t>(suite, "bin", dim, counts);
+        _benchmark_vectors<hdc::int32_t>(suite, "int", dim, counts);
+        _benchmark_vectors<hdc::float_t>(suite, "float", dim, counts);
+        _benchmark_libbin(suite, (dim + 31) / 32);
+    }
 
-TEST_CASE("Vector binary bundle") {
-    const int dim = 10000;
-    const int no_vectors = 1000;
-    auto im = hdc::ItemMemory<hdc::bin_t>(dim, no_vectors);
-    std::vector<hdc::bin_t> test_data;
-    for (int i = 0; i < no_vectors; i++) { test_data.emplace_back(im.at(i)); }
+    if (args.is_used("--json")) {
+        _write_json(args.get("--json"), suite.results());
+    }
+    if (args.is_used("--baseline")) {
+        auto baseline = _read_baseline(args.get("--baseline"));
+        if (_compare(suite.results(), baseline, args.get<double>("--tolerance"))) {
+            return 1;
+        }
+    }
 
-    BENCHMARK("Binary bundle D=10000") {
-        return hdc::add(test_data);
-    };
+    return 0;
 }
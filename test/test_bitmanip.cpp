@@ -0,0 +1,164 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <catch2/catch_test_macros.hpp>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "libbin/bitmanip.hpp"
+
+static const bitmanip::isa_t _ISAS[] = {
+    bitmanip::isa_t::scalar,
+    bitmanip::isa_t::sse42,
+    bitmanip::isa_t::avx2,
+};
+
+// Outputs of every kernel over the same random inputs. Each kernel is run
+// with sizes that do and do not fill the SIMD registers.
+typedef std::vector<std::uint64_t> outputs_t;
+
+static outputs_t _run_unpack() {
+    std::mt19937 rng(1);
+    outputs_t res;
+    for (int i = 0; i < 100; i++) {
+        auto unp = bitmanip::unpack(rng());
+        res.insert(res.end(), unp.begin(), unp.end());
+
+        std::array<std::uint32_t, 32> acc;
+        for (auto& a : acc) { a = rng() % 1000; }
+        bitmanip::accumulate_unpacked(rng(), acc);
+        res.insert(res.end(), acc.begin(), acc.end());
+    }
+    return res;
+}
+
+static outputs_t _run_pack() {
+    std::mt19937 rng(2);
+    outputs_t res;
+    for (int i = 0; i < 100; i++) {
+        // Counters around the threshold, including ones that do not fit in
+        // a signed integer
+        std::uint32_t threshold = i % 2 ? rng() % 64 : 0x80000000u + rng() % 64;
+        std::array<std::uint32_t, 32> acc;
+        for (auto& a : acc) { a = threshold - 2 + rng() % 5; }
+        res.push_back(bitmanip::threshold_pack(acc, threshold));
+
+        std::int32_t counters[32];
+        for (auto& c : counters) { c = static_cast<std::int32_t>(rng() % 9) - 4; }
+        res.push_back(bitmanip::sign_pack(counters));
+
+        bitmanip::accumulate_weighted(rng(), static_cast<std::int32_t>(rng() % 7) - 3, counters);
+        res.insert(res.end(), counters, counters + 32);
+    }
+
+    // Arrays of words, with their counters packed back
+    for (std::size_t words : {0, 1, 3, 9}) {
+        std::vector<std::uint32_t> in(words), out(words);
+        std::vector<std::int32_t> counters(32 * words);
+        for (auto& c : counters) { c = static_cast<std::int32_t>(rng() % 9) - 4; }
+        for (auto& w : in) { w = rng(); }
+        bitmanip::accumulate_weighted(in.data(), words, static_cast<std::int32_t>(rng() % 7) - 3, counters.data());
+        bitmanip::sign_pack(counters.data(), words, out.data());
+        res.insert(res.end(), counters.begin(), counters.end());
+        res.insert(res.end(), out.begin(), out.end());
+    }
+    return res;
+}
+
+static outputs_t _run_majority() {
+    std::mt19937 rng(3);
+    outputs_t res;
+    for (std::size_t n : {1, 2, 3, 16, 33}) {
+        for (std::size_t words : {1, 3, 4, 7, 8, 9, 31, 33}) {
+            std::vector<std::vector<std::uint32_t>> a(n), b(n);
+            std::vector<const std::uint32_t*> pa(n), pb(n);
+            for (std::size_t k = 0; k < n; k++) {
+                for (std::size_t w = 0; w < words; w++) {
+                    a[k].push_back(rng());
+                    b[k].push_back(rng());
+                }
+                pa[k] = a[k].data();
+                pb[k] = b[k].data();
+            }
+
+            for (std::size_t threshold : {std::size_t(0), n / 2, n - 1}) {
+                std::vector<std::uint32_t> out(words);
+                bitmanip::majority(pa.data(), n, words, threshold, out.data());
+                res.insert(res.end(), out.begin(), out.end());
+                bitmanip::xor_majority(pa.data(), pb.data(), n, words, threshold, out.data());
+                res.insert(res.end(), out.begin(), out.end());
+            }
+        }
+    }
+    return res;
+}
+
+static outputs_t _run_hamming() {
+    std::mt19937 rng(4);
+    outputs_t res;
+    for (std::size_t words = 0; words < 40; words++) {
+        std::vector<std::uint32_t> a(words), b(words);
+        for (std::size_t w = 0; w < words; w++) {
+            a[w] = rng();
+            b[w] = rng();
+        }
+        res.push_back(bitmanip::hamming(a.data(), b.data(), words));
+        res.push_back(bitmanip::hamming(a.data(), a.data(), words));
+    }
+    return res;
+}
+
+template<typename Run>
+static void _test_isas(Run run) {
+    auto active = bitmanip::isa();
+    bitmanip::set_isa(bitmanip::isa_t::scalar);
+    auto expected = run();
+
+    for (auto isa : _ISAS) {
+        if (!bitmanip::supported(isa)) {
+            std::cout << "skipping unsupported " << bitmanip::isa_name(isa) << std::endl;
+            continue;
+        }
+        bitmanip::set_isa(isa);
+        REQUIRE(run() == expected);
+    }
+    bitmanip::set_isa(active);
+}
+
+TEST_CASE("Kernels give the same results on every instruction set") {
+    _test_isas(_run_unpack);
+    _test_isas(_run_pack);
+    _test_isas(_run_majority);
+    _test_isas(_run_hamming);
+}
+
+TEST_CASE("Hamming distance") {
+    std::vector<std::uint32_t> a = {0xffffffff, 0x0, 0xf0f0f0f0};
+    std::vector<std::uint32_t> b = {0x0, 0x0, 0x0f0f0f0f};
+    for (auto isa : _ISAS) {
+        if (bitmanip::supported(isa)) {
+            bitmanip::set_isa(isa);
+            REQUIRE(bitmanip::hamming(a.data(), b.data(), a.size()) == 64);
+        }
+    }
+    bitmanip::set_isa("auto");
+}
+
+TEST_CASE("Instruction set selection") {
+    REQUIRE(bitmanip::supported(bitmanip::isa_t::scalar));
+
+    bitmanip::set_isa("scalar");
+    REQUIRE(bitmanip::isa() == bitmanip::isa_t::scalar);
+
+    bool thrown = false;
+    try {
+        bitmanip::set_isa("mmx");
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    REQUIRE(thrown);
+    REQUIRE(bitmanip::isa() == bitmanip::isa_t::scalar);
+    bitmanip::set_isa("auto");
+}
@@ -1,15 +1,132 @@
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <catch2/catch_test_macros.hpp>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory_resource>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "Arena.hpp"
+#include "BindingTable.hpp"
 #include "ContinuousItemMemory.hpp"
+#include "CsvReader.hpp"
+#include "DatasetView.hpp"
+#include "EncodedDataset.hpp"
 #include "ItemMemory.hpp"
+#include "NgramMemory.hpp"
+#include "OpCounters.hpp"
+#include "Quantizer.hpp"
+#include "RecordEncoder.hpp"
+#include "TextEncoder.hpp"
+#include "TextNormalizer.hpp"
+#include "TextScan.hpp"
+#include "ThreadPool.hpp"
+#include "TransposedItemMemory.hpp"
 #include "hdc.hpp"
 #include "types.hpp"
+#include "libbin/bitmanip.hpp"
 
 static const hdc::dim_t _DIM = 1000;
 
+// Count the heap allocations of the whole test program. Every form of the
+// global operators is replaced, so each pointer is freed by the function
+// that matches its allocation. The helpers are not inlined, so the compiler
+// does not pair the malloc() behind operator new with the free() behind
+// operator delete.
+static std::atomic<std::size_t> _allocations(0);
+
+__attribute__((noinline))
+static void* _counted_alloc(std::size_t size, std::size_t alignment=0) {
+    _allocations++;
+    size = size ? size : 1;
+    if (alignment > alignof(std::max_align_t)) {
+        // aligned_alloc() requires a multiple of the alignment
+        size = (size + alignment - 1) / alignment * alignment;
+        return std::aligned_alloc(alignment, size);
+    }
+    return std::malloc(size);
+}
+
+__attribute__((noinline))
+static void _counted_free(void* p) noexcept { std::free(p); }
+
+static void* _counted_new(std::size_t size, std::size_t alignment=0) {
+    if (void* p = _counted_alloc(size, alignment)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size) {
+    return _counted_new(size);
+}
+void* operator new[](std::size_t size) {
+    return _counted_new(size);
+}
+void* operator new(std::size_t size, std::align_val_t al) {
+    return _counted_new(size, static_cast<std::size_t>(al));
+}
+void* operator new[](std::size_t size, std::align_val_t al) {
+    return _counted_new(size, static_cast<std::size_t>(al));
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return _counted_alloc(size);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return _counted_alloc(size);
+}
+void* operator new(
+        std::size_t size, std::align_val_t al, const std::nothrow_t&) noexcept {
+    return _counted_alloc(size, static_cast<std::size_t>(al));
+}
+void* operator new[](
+        std::size_t size, std::align_val_t al, const std::nothrow_t&) noexcept {
+    return _counted_alloc(size, static_cast<std::size_t>(al));
+}
+
+void operator delete(void* p) noexcept { _counted_free(p); }
+void operator delete[](void* p) noexcept { _counted_free(p); }
+void operator delete(void* p, std::size_t) noexcept { _counted_free(p); }
+void operator delete[](void* p, std::size_t) noexcept { _counted_free(p); }
+void operator delete(void* p, std::align_val_t) noexcept {
+    _counted_free(p);
+}
+void operator delete[](void* p, std::align_val_t) noexcept {
+    _counted_free(p);
+}
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    _counted_free(p);
+}
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {
+    _counted_free(p);
+}
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    _counted_free(p);
+}
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    _counted_free(p);
+}
+void operator delete(
+        void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    _counted_free(p);
+}
+void operator delete[](
+        void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    _counted_free(p);
+}
+
 template<typename VectorType>
 static bool _is_orthogonal(const VectorType &a, const VectorType &b) {
     float difference= hdc::dist(a, b);
@@ -69,6 +186,72 @@ TEST_CASE("Bundle") {
     _test_bundle<hdc::double_t>(5, _DIM);
 }
 
+/*
+ * A weighted bundle must be equal to the bundle of a list where each HV is
+ * repeated as many times as its weight.
+ */
+template<typename T>
+static void _test_weighted_bundle(std::size_t entries, hdc::dim_t dim) {
+    std::vector<T> vectors;
+    std::vector<typename hdc::Accumulator<T>::weight_t> weights;
+    std::vector<T> repeated;
+    for (auto i = 0; i < entries; i++) {
+        vectors.emplace_back(T(dim));
+        weights.emplace_back(i+1);
+        for (auto j = 0; j <= i; j++) {
+            repeated.emplace_back(vectors.back());
+        }
+    }
+    T res = hdc::add(vectors, weights);
+    T expected = hdc::add(repeated);
+    REQUIRE(std::equal(res.cbegin(), res.cend(), expected.cbegin()));
+}
+
+TEST_CASE("Weighted bundle") {
+    _test_weighted_bundle<hdc::bin_t>(5, _DIM);
+    _test_weighted_bundle<hdc::bin_t>(6, _DIM);
+    _test_weighted_bundle<hdc::int32_t>(5, _DIM);
+    _test_weighted_bundle<hdc::float_t>(5, _DIM);
+}
+
+/*
+ * Subtracting HVs from a bundle must be equal to bundling their inverses, and
+ * subtracting an added HV must undo its addition.
+ */
+template<typename T>
+static void _test_subtract(std::size_t entries, hdc::dim_t dim) {
+    std::vector<T> vectors, subtracted, inverted;
+    for (auto i = 0; i < entries; i++) {
+        vectors.emplace_back(T(dim));
+        subtracted.emplace_back(T(dim));
+        inverted.emplace_back(subtracted.back());
+        inverted.back().invert();
+    }
+    std::vector<T> list(vectors);
+    list.insert(list.end(), inverted.begin(), inverted.end());
+    T res = hdc::subtract(vectors, subtracted);
+    T expected = hdc::add(list);
+    REQUIRE(std::equal(res.cbegin(), res.cend(), expected.cbegin()));
+
+    hdc::Accumulator<T> acc(dim);
+    for (const auto& v : vectors) {
+        acc.add(v);
+    }
+    acc.add(subtracted[0], 2);
+    acc.subtract(subtracted[0]);
+    acc.subtract(subtracted[0]);
+    res = acc.result();
+    expected = hdc::add(vectors);
+    REQUIRE(std::equal(res.cbegin(), res.cend(), expected.cbegin()));
+}
+
+TEST_CASE("Subtracted bundle") {
+    _test_subtract<hdc::bin_t>(3, _DIM);
+    _test_subtract<hdc::bin_t>(4, _DIM);
+    _test_subtract<hdc::int32_t>(3, _DIM);
+    _test_subtract<hdc::float_t>(3, _DIM);
+}
+
 /*
  * Given a set of HVs, the binding operation on them must result in a HV that
  * is dissimilar to all original HVs.
@@ -93,12 +276,138 @@ TEST_CASE("Binding") {
     _test_bind<hdc::double_t>(5, _DIM);
 }
 
+/*
+ * Encoding a record must give the same vector as bundling the binding of each
+ * feature ID with the level of the feature.
+ */
+template<typename T>
+static void _test_record(std::size_t features, hdc::dim_t dim) {
+    auto ids = hdc::ItemMemory<T>(features, dim);
+    auto levels = hdc::ContinuousItemMemory<T>(10, dim);
+
+    std::vector<std::uint32_t> values;
+    std::vector<T> bound;
+    for (std::size_t i = 0; i < features; i++) {
+        values.emplace_back((i * 7) % levels.size());
+        bound.emplace_back(hdc::mul(ids.at(i), levels.at(values.back())));
+    }
+    T res = hdc::encode_record(ids, levels, values.data(), values.size());
+    T expected = hdc::add(bound);
+    REQUIRE(std::equal(res.cbegin(), res.cend(), expected.cbegin()));
+
+    // Encoding into a vector that already holds data overwrites it
+    T reused = ids.at(0);
+    hdc::encode_record_into(reused, ids, levels, values.data(), values.size());
+    REQUIRE(std::equal(reused.cbegin(), reused.cend(), expected.cbegin()));
+}
+
+TEST_CASE("Record encoding") {
+    _test_record<hdc::bin_t>(7, _DIM);
+    _test_record<hdc::bin_t>(8, _DIM+32);
+    _test_record<hdc::int32_t>(7, _DIM);
+    _test_record<hdc::float_t>(7, _DIM);
+}
+
+/*
+ * Encoding a record from a binding table must give the same vector as
+ * hdc::encode_record(). Binary records with an even number of features
+ * check the threshold of the majority.
+ */
+template<typename T>
+static void _test_binding_table(std::size_t features, hdc::dim_t dim) {
+    auto ids = hdc::ItemMemory<T>(features, dim);
+    auto levels = hdc::ContinuousItemMemory<T>(10, dim);
+    hdc::BindingTable<T> table(ids, levels);
+    REQUIRE(table.features() == features);
+    REQUIRE(table.levels() == levels.size());
+
+    for (int round = 0; round < 3; round++) {
+        std::vector<std::uint32_t> values;
+        for (std::size_t i = 0; i < features; i++) {
+            values.emplace_back(std::rand() % levels.size());
+        }
+        T expected = hdc::encode_record(ids, levels, values.data(), values.size());
+        T res = table.encode(values.data(), values.size());
+        REQUIRE(std::equal(res.cbegin(), res.cend(), expected.cbegin()));
+
+        T reused = ids.at(0);
+        table.encode_into(reused, values.data(), values.size());
+        REQUIRE(std::equal(reused.cbegin(), reused.cend(), expected.cbegin()));
+    }
+}
+
+TEST_CASE("Binding table") {
+    _test_binding_table<hdc::bin_t>(7, _DIM);
+    _test_binding_table<hdc::bin_t>(8, _DIM+32);
+    _test_binding_table<hdc::int32_t>(7, _DIM);
+    _test_binding_table<hdc::int32_t>(8, _DIM);
+    _test_binding_table<hdc::float_t>(7, _DIM);
+    _test_binding_table<hdc::float_t>(8, _DIM);
+}
+
 /*
  * The permute operation must result in a vector that is orthogonal to the
  * original
  */
+template<typename T>
+static bool _equal(const T& a, const T& b) {
+    return std::equal(a.cbegin(), a.cend(), b.cbegin());
+}
+
+template<typename T>
+static void _test_permute(hdc::dim_t dim) {
+    T v(dim);
+    const hdc::dim_t size = v.size();
+    REQUIRE(_is_orthogonal(v, hdc::p(v, 1)));
+
+    for (std::uint32_t times : {0u, 1u, 5u, 31u, 32u, 33u, 64u, 100u}) {
+        T rotated = hdc::p(v, times);
+
+        // Permutations are rotations, so they can be undone
+        T back = rotated;
+        back.p(size - times % size);
+        REQUIRE(_equal(back, v));
+
+        // Rotated views read the same entries as the permuted vector
+        auto view = hdc::p_view(v, times);
+        T materialized(size, false);
+        view.materialize(materialized);
+        REQUIRE(_equal(materialized, rotated));
+        for (hdc::dim_t d = 0; d < size; d += 7) {
+            REQUIRE(view.get(d) == rotated.get(d));
+        }
+
+        T other(dim);
+        REQUIRE(view.dist(other) == rotated.dist(other));
+
+        T bound = other;
+        bound.mul(view);
+        REQUIRE(_equal(bound, hdc::mul(other, rotated)));
+
+        std::vector<hdc::RotatedView<std::remove_const_t<std::remove_pointer_t<
+                decltype(v.data())>>>> views = {view, view, hdc::p_view(other, 0)};
+        REQUIRE(_equal(hdc::add(views), hdc::add(std::vector<T>{rotated, rotated, other})));
+
+        hdc::Accumulator<T> acc(dim), expected(dim);
+        acc.add(view, 3);
+        expected.add(rotated, 3);
+        REQUIRE(_equal(acc.result(), expected.result()));
+    }
+}
+
 TEST_CASE("Permute") {
+    _test_permute<hdc::bin_t>(_DIM);
+    _test_permute<hdc::int32_t>(_DIM);
+    _test_permute<hdc::float_t>(_DIM);
 
+    // Binary vectors rotate towards the lower dimensions across the words
+    hdc::bin_t v(64, false);
+    v.set(32, 1);
+    v.set(0, 1);
+    v.p(1);
+    REQUIRE(v.get(31) == 1);
+    REQUIRE(v.get(63) == 1);
+    REQUIRE(v.hamming(hdc::bin_t(64, false)) == 2);
 }
 
 /*
@@ -152,3 +461,773 @@ TEST_CASE("Continuous Item Memory") {
     _test_cim<hdc::double_t>(100, _DIM);
 }
 
+/*
+ * Every entry of an n-gram table must be the encoding of its symbols, and a
+ * saved table must be mapped back with the same entries.
+ */
+template<typename T>
+static void _test_ngram_table(const std::string& name) {
+    const std::size_t alphabet = 5;
+    const std::size_t n = 3;
+    hdc::ItemMemory<T> im(alphabet, _DIM);
+    hdc::NgramMemory<T> table(im, n);
+    REQUIRE(table.size() == alphabet * alphabet * alphabet);
+    REQUIRE(!table.mapped());
+
+    const std::size_t symbols[n] = {4, 0, 2};
+    T expected = hdc::NgramMemory<T>::encode(im, symbols, n);
+    REQUIRE(_equal(T(table.view(table.index(symbols))), expected));
+
+    auto path = std::filesystem::temp_directory_path() / ("hdc_test_ngram_" + name + ".bin");
+    table.save(path.string());
+    {
+        hdc::NgramMemory<T> mapped(path.string(), alphabet, n);
+        REQUIRE(mapped.mapped());
+        REQUIRE(mapped.dim() == table.dim());
+        for (std::size_t i = 0; i < table.size(); i++) {
+            REQUIRE(_equal(mapped.at(i), table.at(i)));
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("N-gram table") {
+    _test_ngram_table<hdc::bin_t>("bin");
+    _test_ngram_table<hdc::int32_t>("int");
+    _test_ngram_table<hdc::float_t>("float");
+}
+
+/*
+ * A text streamed in chunks must be encoded the same as the whole text, with
+ * runs of separators collapsed across the chunk boundaries.
+ */
+template<typename T>
+static void _test_text_stream(bool table) {
+    const std::string text = "The quick  brown fox,   jumps over... the lazy dog!  "
+                             "Pack my box with five dozen liquor jugs.";
+    hdc::TextNormalizer normalizer(true);
+    hdc::ItemMemory<T> im(normalizer.alphabet(), _DIM);
+    hdc::NgramMemory<T> ngrams(im, 3);
+    const hdc::NgramMemory<T>* lookup = table ? &ngrams : nullptr;
+
+    std::vector<std::uint8_t> symbols;
+    normalizer.normalize(text, symbols);
+    T expected = hdc::encode_text(im, lookup, symbols.data(), symbols.size(), 3);
+
+    hdc::TextStream<T> stream(normalizer, im, lookup, 3);
+    for (std::size_t chunk : {1, 2, 5, 7, 32, 33}) {
+        stream.clear();
+        for (std::size_t pos = 0; pos < text.size(); pos += chunk) {
+            stream.feed(std::string_view(text).substr(pos, chunk));
+        }
+        REQUIRE(stream.ngrams() == symbols.size() - 3);
+        REQUIRE(_equal(stream.result(), expected));
+    }
+}
+
+TEST_CASE("Text streams") {
+    _test_text_stream<hdc::bin_t>(false);
+    _test_text_stream<hdc::bin_t>(true);
+    _test_text_stream<hdc::int32_t>(false);
+    _test_text_stream<hdc::float_t>(true);
+}
+
+
+/*
+ * Operation counters count every operation when they are compiled in and
+ * stay at zero otherwise.
+ */
+template<typename T>
+static void _test_op_counters(hdc::dim_t dim) {
+    using counters = hdc::OpCounters;
+    auto im = hdc::ItemMemory<T>(3, dim);
+    counters::reset();
+
+    auto bound = hdc::mul(im.at(0), im.at(1));
+    bound.p(2);
+    bound.dist(im.at(2));
+    auto counts = counters::total();
+
+    std::uint64_t expected = counters::enabled() ? 1 : 0;
+    REQUIRE(counts.ops[counters::bind] == expected);
+    REQUIRE(counts.ops[counters::permute] == expected);
+    REQUIRE(counts.ops[counters::distance] == expected);
+    REQUIRE(counts.ops[counters::lookup] == 3*expected);
+    // Lookups do not copy, only the result of mul() does
+    REQUIRE(counts.ops[counters::copy] == expected);
+    REQUIRE(counts.ops[counters::alloc] == 0);
+    REQUIRE((counts.words[counters::bind] > 0) == counters::enabled());
+}
+
+TEST_CASE("Operation counters") {
+    _test_op_counters<hdc::bin_t>(_DIM);
+    _test_op_counters<hdc::int32_t>(_DIM);
+}
+
+/*
+ * Moves must not copy, and the *_into() operations must not allocate once
+ * their output has the dimension of the operands. Move assignments may copy
+ * between different resources, so only the move constructors are noexcept.
+ */
+static_assert(std::is_nothrow_move_constructible_v<hdc::bin_t>);
+static_assert(std::is_nothrow_move_constructible_v<hdc::float_t>);
+
+template<typename T>
+static void _test_into(hdc::dim_t dim) {
+    auto ids = hdc::ItemMemory<T>(8, dim);
+    auto levels = hdc::ContinuousItemMemory<T>(4, dim);
+    auto am = hdc::AssociativeMemory<T>(std::vector<T>{ids.at(0), ids.at(1)});
+    std::vector<std::uint32_t> values = {0, 1, 2, 3, 3, 2, 1};
+    std::vector<T> bundled = {ids.at(0), ids.at(1), ids.at(2)};
+
+    // The results are the same as the allocating operations
+    T out(dim, false);
+    T tmp(dim, false);
+    hdc::mul_into(out, ids.at(0), ids.at(1));
+    T expected = hdc::mul(ids.at(0), ids.at(1));
+    REQUIRE(std::equal(out.cbegin(), out.cend(), expected.cbegin()));
+    hdc::p_into(out, out, 3);
+    expected = hdc::p(expected, 3);
+    REQUIRE(std::equal(out.cbegin(), out.cend(), expected.cbegin()));
+    hdc::add_into(out, bundled);
+    expected = hdc::add(bundled);
+    REQUIRE(std::equal(out.cbegin(), out.cend(), expected.cbegin()));
+    hdc::add_into(out, ids.at(0), ids.at(1), ids.at(2));
+    expected = hdc::add(ids.at(0), ids.at(1), ids.at(2));
+    REQUIRE(std::equal(out.cbegin(), out.cend(), expected.cbegin()));
+
+    // Steady state encoding. The first round sets up the reused buffers.
+    std::size_t allocations = 0;
+    for (int round = 0; round < 3; round++) {
+        std::size_t before = _allocations;
+        for (std::size_t i = 0; i < ids.size(); i++) {
+            hdc::encode_record_into(out, ids, levels, values.data(), values.size());
+            hdc::p_into(tmp, ids.at(i), i);
+            hdc::mul_into(tmp, tmp, levels.at(i % levels.size()));
+            hdc::add_into(out, out, tmp, ids.at(i));
+            hdc::add_into(tmp, bundled);
+            am.search(out);
+            T moved(std::move(tmp));
+            tmp = std::move(moved);
+        }
+        allocations = _allocations - before;
+    }
+    REQUIRE(allocations == 0);
+}
+
+TEST_CASE("Operations into existing vectors") {
+    _test_into<hdc::bin_t>(_DIM);
+    _test_into<hdc::int32_t>(_DIM);
+    _test_into<hdc::float_t>(_DIM);
+}
+
+/*
+ * Temporaries allocated from the arena of the thread give the same results
+ * and do not use the heap once the arena has grown to fit a query.
+ */
+template<typename T>
+static void _test_arena(hdc::dim_t dim) {
+    auto ids = hdc::ItemMemory<T>(32, dim);
+    std::vector<T> items;
+    for (std::size_t i = 0; i < ids.size(); i++) {
+        items.emplace_back(ids.at(i));
+        items.back().p(i % 2);
+    }
+    T expected = hdc::add(items);
+
+    T out(dim, false);
+    bool from_arena = false;
+    std::size_t allocations = 0;
+    for (int round = 0; round < 3; round++) {
+        std::size_t before = _allocations;
+        {
+            hdc::ScopedArena arena;
+            std::pmr::vector<T> vec(arena.resource());
+            vec.reserve(ids.size());
+            for (std::size_t i = 0; i < ids.size(); i++) {
+                vec.emplace_back(ids.at(i));
+                vec.back().p(i % 2);
+            }
+            from_arena = vec.back().get_allocator().resource() == arena.resource();
+            hdc::add_into(out, vec);
+        }
+        allocations = _allocations - before;
+    }
+    REQUIRE(from_arena);
+    REQUIRE(allocations == 0);
+    REQUIRE(std::equal(out.cbegin(), out.cend(), expected.cbegin()));
+
+    // Copies of arena vectors use the default resource
+    T copy(expected, hdc::Arena::local().resource());
+    T heap(copy);
+    REQUIRE(heap.get_allocator().resource() == std::pmr::get_default_resource());
+
+    // Moving an arena vector into a heap vector copies the entries and keeps
+    // the heap resource
+    T moved(dim, false);
+    moved = std::move(copy);
+    REQUIRE(moved.get_allocator().resource() == std::pmr::get_default_resource());
+    REQUIRE(std::equal(moved.cbegin(), moved.cend(), expected.cbegin()));
+}
+
+TEST_CASE("Arena allocation") {
+    _test_arena<hdc::bin_t>(_DIM);
+    _test_arena<hdc::int32_t>(_DIM);
+    _test_arena<hdc::float_t>(_DIM);
+
+    // Nested scopes keep the memory of the enclosing scope
+    auto &arena = hdc::Arena::local();
+    std::size_t capacity = arena.capacity();
+    {
+        hdc::ScopedArena outer;
+        void *p = outer.resource()->allocate(capacity);
+        {
+            // The inner scope allocates after the memory of the outer one
+            hdc::ScopedArena inner;
+            void *q = inner.resource()->allocate(16, 16);
+            REQUIRE(reinterpret_cast<std::uintptr_t>(q) % 16 == 0);
+            REQUIRE((static_cast<char*>(q) >= static_cast<char*>(p) + capacity ||
+                     static_cast<char*>(q) + 16 <= static_cast<char*>(p)));
+            std::fill_n(static_cast<char*>(q), 16, 1);
+        }
+        std::fill_n(static_cast<char*>(p), capacity, 0);
+    }
+    // The arena grew to fit the released allocations
+    REQUIRE(arena.capacity() > capacity);
+}
+
+/*
+ * Views over memory owned by someone else give the same results as the
+ * vectors they were copied from.
+ */
+template<typename T>
+static void _test_views(hdc::dim_t dim) {
+    using entry_t = std::remove_const_t<std::remove_pointer_t<
+            decltype(std::declval<const T&>().data())>>;
+    using view_t = typename T::view_type;
+
+    auto ids = hdc::ItemMemory<T>(4, dim);
+    auto am = hdc::AssociativeMemory<T>(std::vector<T>{ids.at(0), ids.at(1), ids.at(2)});
+
+    // A buffer holding the rows of ids, as received from elsewhere
+    std::vector<entry_t> buffer;
+    for (std::size_t i = 0; i < ids.size(); i++) {
+        buffer.insert(buffer.end(), ids.at(i).cbegin(), ids.at(i).cend());
+    }
+    const std::size_t cols = std::distance(ids.at(0).cbegin(), ids.at(0).cend());
+    std::vector<view_t> views;
+    for (std::size_t i = 0; i < ids.size(); i++) {
+        views.emplace_back(buffer.data() + i*cols, dim);
+    }
+
+    REQUIRE(views[0].size() == ids.at(0).size());
+    REQUIRE(views[0].dist(views[1]) == ids.at(0).dist(ids.at(1)));
+    REQUIRE(ids.at(0).dist(views[1]) == views[0].dist(ids.at(1)));
+    for (std::size_t i = 0; i < ids.size(); i++) {
+        REQUIRE(am.search(views[i]) == am.search(ids.at(i)));
+    }
+
+    T copy(views[2]);
+    REQUIRE(std::equal(copy.cbegin(), copy.cend(), ids.at(2).cbegin()));
+
+    std::vector<T> vectors = {ids.at(0), ids.at(1), ids.at(3)};
+    std::vector<view_t> bundled = {views[0], views[1], views[3]};
+    T expected = hdc::add(vectors);
+    T out = hdc::add(bundled);
+    REQUIRE(std::equal(out.cbegin(), out.cend(), expected.cbegin()));
+
+    // Operations write into the buffer without copies
+    hdc::MutableVectorView<entry_t> row(buffer.data() + 3*cols, dim);
+    hdc::add_into(row, std::vector<view_t>{views[0], views[1], views[2]});
+    expected = hdc::add(std::vector<T>{ids.at(0), ids.at(1), ids.at(2)});
+    REQUIRE(std::equal(row.data(), row.data() + cols, expected.cbegin()));
+
+    hdc::mul_into(row, views[0], views[1]);
+    expected = hdc::mul(ids.at(0), ids.at(1));
+    REQUIRE(std::equal(row.data(), row.data() + cols, expected.cbegin()));
+
+    bool thrown = false;
+    try {
+        T small(dim/2);
+        small.dist(views[0]);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    REQUIRE(thrown);
+}
+
+TEST_CASE("Vector views") {
+    _test_views<hdc::bin_t>(_DIM);
+    _test_views<hdc::int32_t>(_DIM);
+    _test_views<hdc::float_t>(_DIM);
+}
+
+// Run "test" with the kernels of every instruction set the CPU supports
+template<typename Test>
+static void _for_each_isa(Test test) {
+    auto active = bitmanip::isa();
+    for (auto isa : {bitmanip::isa_t::scalar, bitmanip::isa_t::sse42, bitmanip::isa_t::avx2}) {
+        if (bitmanip::supported(isa)) {
+            bitmanip::set_isa(isa);
+            test();
+        }
+    }
+    bitmanip::set_isa(active);
+}
+
+/*
+ * Values on a boundary belong to the lower level, values out of the range
+ * to the first or last level and NaN to the first level. Quantizing an array
+ * must give the level of each value, on every instruction set.
+ */
+TEST_CASE("Quantizer") {
+    // Steps of one, so that the boundaries are exact
+    hdc::Quantizer exact(0.0, 8.0, 8);
+    REQUIRE(exact(0.0) == 0);
+    REQUIRE(exact(0.5) == 0);
+    REQUIRE(exact(1.0) == 0);
+    REQUIRE(exact(1.5) == 1);
+    REQUIRE(exact(2.0) == 1);
+    REQUIRE(exact(7.0) == 6);
+    REQUIRE(exact(7.5) == 7);
+    REQUIRE(exact(8.0) == 7);
+    REQUIRE(exact(-0.5) == 0);
+    REQUIRE(exact(-1000.0) == 0);
+    REQUIRE(exact(8.5) == 7);
+    REQUIRE(exact(1000.0) == 7);
+    REQUIRE(exact(std::numeric_limits<float>::quiet_NaN()) == 0);
+    REQUIRE(exact(std::numeric_limits<float>::infinity()) == 7);
+    REQUIRE(exact(-std::numeric_limits<float>::infinity()) == 0);
+
+    hdc::Quantizer tenths(-1.0, 1.0, 20);
+    REQUIRE(tenths(-1.0) == 0);
+    REQUIRE(tenths(-0.9) == 0);
+    REQUIRE(tenths(-0.85) == 1);
+    REQUIRE(tenths(0.05) == 10);
+    REQUIRE(tenths(1.0) == 19);
+
+    const std::vector<float> data = {3.0, -2.0, 7.0, 0.0};
+    auto fitted = hdc::Quantizer::fit(data.data(), data.size(), 9);
+    REQUIRE(fitted.min() == -2.0);
+    REQUIRE(fitted.max() == 7.0);
+    REQUIRE(fitted.levels() == 9);
+    REQUIRE(fitted(-2.0) == 0);
+    REQUIRE(fitted(-1.0) == 0);
+    REQUIRE(fitted(-0.5) == 1);
+    REQUIRE(fitted(7.0) == 8);
+    REQUIRE_THROWS_AS(hdc::Quantizer::fit(data.data(), 0, 9), std::runtime_error);
+
+    REQUIRE_THROWS_AS(hdc::Quantizer(-1.0, 1.0, 0), std::runtime_error);
+    REQUIRE_THROWS_AS(hdc::Quantizer(1.0, 1.0, 10), std::runtime_error);
+    REQUIRE_THROWS_AS(hdc::Quantizer(1.0, -1.0, 10), std::runtime_error);
+
+    hdc::Quantizer quantizer(-1.0, 1.0, 21);
+    std::vector<float> values;
+    for (int i = -110; i <= 110; i++) {
+        values.push_back(i / 100.0);
+    }
+    values.push_back(-1.0);
+    values.push_back(1.0);
+    values.push_back(100.0);
+    values.push_back(-100.0);
+    // Inside a block of the SIMD path
+    values.insert(values.begin() + 3, std::numeric_limits<float>::quiet_NaN());
+    std::vector<double> doubles(values.begin(), values.end());
+
+    _for_each_isa([&]() {
+        std::vector<std::uint32_t> levels(values.size()), from_doubles(values.size());
+        quantizer.quantize(values.data(), values.size(), levels.data());
+        quantizer.quantize(doubles.data(), doubles.size(), from_doubles.data());
+        for (std::size_t i = 0; i < values.size(); i++) {
+            REQUIRE(levels[i] == quantizer(values[i]));
+            REQUIRE(from_doubles[i] == quantizer(values[i]));
+            REQUIRE(levels[i] < quantizer.levels());
+        }
+    });
+}
+
+/*
+ * Bundling items through a transposed IM must be equal to bundling the items
+ * selected by the mask and the permutation of the others, on every
+ * instruction set.
+ */
+TEST_CASE("Transposed Item Memory") {
+    for (std::size_t items : {5, 300, 784}) {
+        hdc::ItemMemory<hdc::bin_t> im(items, _DIM);
+        hdc::TransposedItemMemory transposed(im);
+
+        std::vector<std::uint64_t> mask(hdc::TransposedItemMemory::words(items), 0);
+        std::vector<hdc::bin_t> selected;
+        for (std::size_t i = 0; i < items; i++) {
+            if (std::rand() % 2) {
+                mask[i / 64] |= std::uint64_t(1) << (i % 64);
+                selected.emplace_back(im.at(i));
+            }
+            else {
+                selected.emplace_back(hdc::p(im.at(i), 1));
+            }
+        }
+        hdc::bin_t expected = hdc::add(selected);
+
+        _for_each_isa([&]() {
+            REQUIRE(_equal(transposed.encode(mask.data()), expected));
+        });
+    }
+}
+
+// Write "text" to a file in the temporary directory and return its path
+static std::string _temp_file(const std::string& name, const std::string& text) {
+    auto path = (std::filesystem::temp_directory_path() / name).string();
+    std::ofstream(path, std::ios::binary) << text;
+    return path;
+}
+
+// Message of the error thrown while reading a CSV file, empty if none is
+template<typename T>
+static std::string _csv_error(const std::string& path) {
+    try {
+        hdc::read_csv<T>(path);
+    } catch (const std::runtime_error& e) {
+        return e.what();
+    }
+    return "";
+}
+
+/*
+ * CSV files are read with their CRLF line ends, empty lines, blanks around
+ * the values and leading '+' signs, and rows of a file larger than a chunk
+ * are read across the chunk boundaries.
+ */
+TEST_CASE("CSV reader") {
+    auto path = _temp_file("hdc_test_small.csv",
+                           "1, 2.5,+3\r\n\r\n-4,5e1 ,6\n\n\t7,8,\t9\r\n");
+    auto floats = hdc::read_csv<float>(path);
+    REQUIRE(floats.rows() == 3);
+    REQUIRE(floats.cols() == 3);
+    const std::vector<float> expected_floats = {1, 2.5, 3, -4, 50, 6, 7, 8, 9};
+    REQUIRE(std::equal(floats.begin(), floats.end(), expected_floats.begin()));
+
+    // The last line does not need a newline
+    path = _temp_file("hdc_test_small.csv", "1,2,+3\r\n\r\n-4, 5 ,6\n\n7,8,9");
+    auto ints = hdc::read_csv<int>(path);
+    REQUIRE(ints.rows() == 3);
+    const std::vector<int> expected_ints = {1, 2, 3, -4, 5, 6, 7, 8, 9};
+    REQUIRE(std::equal(ints.begin(), ints.end(), expected_ints.begin()));
+
+    // Errors give the row, counted without the empty lines
+    path = _temp_file("hdc_test_small.csv", "1,2,3\n\n4,5\n");
+    REQUIRE(_csv_error<float>(path).find("row 1: expected 3 columns") != std::string::npos);
+    path = _temp_file("hdc_test_small.csv", "1,2,3\n4,5,6,7\n");
+    REQUIRE(_csv_error<float>(path).find("row 1: expected 3 columns") != std::string::npos);
+    path = _temp_file("hdc_test_small.csv", "1,2,3\n4,5,6\n7,x,9\n");
+    REQUIRE(_csv_error<float>(path).find("row 2: invalid value in column 1") != std::string::npos);
+    path = _temp_file("hdc_test_small.csv", "1,2,3\n4,5.5,6\n");
+    REQUIRE(!_csv_error<int>(path).empty());
+    std::filesystem::remove(path);
+
+    // Some MiB of rows, so that chunks end in the middle of rows
+    const int rows = 200000;
+    std::string text;
+    for (int r = 0; r < rows; r++) {
+        text += std::to_string(r) + ",-" + std::to_string(r) + ",+" + std::to_string(r % 1000);
+        text += (r % 7 == 0) ? "\r\n" : "\n";
+        if (r % 11 == 0) {
+            text += "\n";
+        }
+    }
+    path = _temp_file("hdc_test_large.csv", text);
+    auto large = hdc::read_csv<int>(path);
+    REQUIRE(large.rows() == rows);
+    REQUIRE(large.cols() == 3);
+    auto large_floats = hdc::read_csv<float>(path);
+    for (int r = 0; r < rows; r++) {
+        REQUIRE(large(r, 0) == r);
+        REQUIRE(large(r, 1) == -r);
+        REQUIRE(large(r, 2) == r % 1000);
+        REQUIRE(large_floats(r, 1) == -r);
+    }
+
+    // A ragged row after the first chunk is found with its number
+    text += "1,2\n";
+    path = _temp_file("hdc_test_large.csv", text);
+    REQUIRE(_csv_error<int>(path).find("row " + std::to_string(rows) + ":") != std::string::npos);
+    std::filesystem::remove(path);
+}
+
+/*
+ * A cached dataset is mapped back when it was saved with the same key, and
+ * encoded again when the file holds another key or is not complete.
+ */
+template<typename T>
+static void _test_encoded_cache(const std::string& name) {
+    const std::size_t size = 50;
+    auto im = hdc::ItemMemory<T>(size, _DIM);
+    std::atomic<std::size_t> encoded(0);
+    auto encode = [&](std::size_t i) {
+        encoded++;
+        return T(im.at(i));
+    };
+    auto dir = (std::filesystem::temp_directory_path() / "hdc_test_cache").string();
+    std::filesystem::remove_all(dir);
+
+    auto first = hdc::EncodedDataset<T>::cached(dir, name, "key", size, _DIM, encode);
+    REQUIRE(!first.mapped());
+    REQUIRE(encoded == size);
+    auto path = hdc::encoded_cache_path(dir, name, "key");
+    REQUIRE(std::filesystem::is_regular_file(path));
+
+    auto mapped = hdc::EncodedDataset<T>::cached(dir, name, "key", size, _DIM, encode);
+    REQUIRE(mapped.mapped());
+    REQUIRE(encoded == size);
+    REQUIRE(mapped.size() == size);
+    REQUIRE(mapped.dim() == _DIM);
+    for (std::size_t i = 0; i < size; i++) {
+        REQUIRE(_equal(mapped.at(i), im.at(i)));
+    }
+
+    // The file of another key, even under the name of this one
+    auto other = hdc::encoded_cache_path(dir, name, "other key");
+    REQUIRE(other != path);
+    std::filesystem::copy_file(path, other);
+    auto again = hdc::EncodedDataset<T>::cached(dir, name, "other key", size, _DIM, encode);
+    REQUIRE(!again.mapped());
+    REQUIRE(encoded == 2*size);
+
+    // A truncated file
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    again = hdc::EncodedDataset<T>::cached(dir, name, "key", size, _DIM, encode);
+    REQUIRE(!again.mapped());
+    REQUIRE(encoded == 3*size);
+
+    // A file of another version, with a different magic
+    {
+        std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(6);
+        f.put('1');
+    }
+    again = hdc::EncodedDataset<T>::cached(dir, name, "key", size, _DIM, encode);
+    REQUIRE(!again.mapped());
+    REQUIRE(encoded == 4*size);
+    for (std::size_t i = 0; i < size; i++) {
+        REQUIRE(_equal(again.at(i), im.at(i)));
+    }
+
+    // The rewritten file is mapped again
+    again = hdc::EncodedDataset<T>::cached(dir, name, "key", size, _DIM, encode);
+    REQUIRE(again.mapped());
+    REQUIRE(encoded == 4*size);
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Encoded dataset cache") {
+    _test_encoded_cache<hdc::bin_t>("bin");
+    _test_encoded_cache<hdc::int32_t>("int");
+    _test_encoded_cache<hdc::float_t>("float");
+}
+
+/*
+ * Every index of a range must run exactly once, also in nested calls, and
+ * reductions must give the same result for any number of threads.
+ */
+TEST_CASE("Thread pool") {
+    const std::size_t size = 10000;
+    const std::size_t outer = 24;
+    const std::size_t inner = 300;
+    std::vector<double> sums;
+    std::vector<std::size_t> nested_sums;
+    for (std::size_t threads : {1, 2, 3, 8}) {
+        hdc::ThreadPool::set_threads(threads);
+        auto &pool = hdc::ThreadPool::global();
+        REQUIRE(pool.size() == threads);
+
+        std::vector<std::atomic<int>> runs(size);
+        pool.parallel_for(0, size, [&](std::size_t i) { runs[i]++; }, 7);
+        REQUIRE(std::all_of(runs.begin(), runs.end(), [](const auto &r) { return r == 1; }));
+
+        // Nested calls are helped by the waiting threads
+        std::vector<std::atomic<int>> nested(outer*inner);
+        pool.parallel_for(0, outer, [&](std::size_t o) {
+            pool.parallel_for(0, inner, [&](std::size_t i) { nested[o*inner + i]++; }, 5);
+        });
+        REQUIRE(std::all_of(nested.begin(), nested.end(), [](const auto &r) { return r == 1; }));
+
+        // The sum of floating point values depends on the order of the
+        // additions, so it is only equal if the chunks are the same
+        sums.push_back(pool.parallel_reduce(
+                0, size, 64, 0.0,
+                [](double &sum, std::size_t i) { sum += 1.0 / (i + 1); },
+                [](double &res, double partial) { res += partial; }));
+
+        nested_sums.push_back(pool.parallel_reduce(
+                0, outer, 1, std::size_t(0),
+                [&](std::size_t &sum, std::size_t o) {
+                    sum += pool.parallel_reduce(
+                            0, inner, 16, std::size_t(0),
+                            [&](std::size_t &s, std::size_t i) { s += o*inner + i; },
+                            [](std::size_t &res, std::size_t partial) { res += partial; });
+                },
+                [](std::size_t &res, std::size_t partial) { res += partial; }));
+    }
+    hdc::ThreadPool::set_threads(0);
+
+    REQUIRE(std::all_of(sums.begin(), sums.end(), [&](double s) { return s == sums[0]; }));
+    const std::size_t n = outer*inner;
+    REQUIRE(std::all_of(nested_sums.begin(), nested_sums.end(),
+                        [&](std::size_t s) { return s == n*(n-1)/2; }));
+}
+
+// Whether the records of "view" are the rows "rows" of a matrix whose entries
+// are 10*row + col
+static bool _has_rows(const hdc::DatasetView<int>& view, const std::vector<int>& rows) {
+    if (view.size() != rows.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < rows.size(); i++) {
+        for (std::size_t c = 0; c < view.cols(); c++) {
+            if (view.at(i)[c] != 10*rows[i] + int(c)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ * Slices, strides and selections of dataset views compose, and only views of
+ * consecutive records are contiguous.
+ */
+TEST_CASE("Dataset views") {
+    hdc::Matrix<int> matrix(10, 3);
+    for (std::size_t r = 0; r < matrix.rows(); r++) {
+        for (std::size_t c = 0; c < matrix.cols(); c++) {
+            matrix(r, c) = 10*r + c;
+        }
+    }
+    auto all = hdc::DatasetView<int>::own(std::move(matrix));
+    REQUIRE(_has_rows(all, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+    REQUIRE(all.contiguous() == all[0]);
+
+    auto slice = all.slice(2, 7);
+    REQUIRE(_has_rows(slice, {2, 3, 4, 5, 6}));
+    REQUIRE(slice.contiguous() == all[2]);
+    REQUIRE(_has_rows(all.slice(4, 4), {}));
+
+    auto stride = all.stride(3);
+    REQUIRE(_has_rows(stride, {0, 3, 6, 9}));
+    REQUIRE(stride.contiguous() == nullptr);
+    REQUIRE(_has_rows(all.slice(1, 8).stride(3), {1, 4, 7}));
+
+    // Slices of strides keep the step, unless they hold a single record
+    auto strided_slice = all.stride(2).slice(1, 4);
+    REQUIRE(_has_rows(strided_slice, {2, 4, 6}));
+    REQUIRE(strided_slice.contiguous() == nullptr);
+    REQUIRE(_has_rows(strided_slice.stride(2), {2, 6}));
+    REQUIRE(all.stride(2).slice(3, 4).contiguous() == all[6]);
+
+    // Selections of strides index the records of the stride
+    auto selected = all.stride(2).select({4, 0, 2});
+    REQUIRE(_has_rows(selected, {8, 0, 4}));
+    REQUIRE(selected.contiguous() == nullptr);
+    REQUIRE(_has_rows(selected.slice(1, 3), {0, 4}));
+    REQUIRE(_has_rows(selected.stride(2), {8, 4}));
+    REQUIRE(_has_rows(all.slice(5, 10).stride(2).select({2, 1}), {9, 7}));
+
+    REQUIRE_THROWS_AS(all.at(10), std::out_of_range);
+    REQUIRE_THROWS_AS(all.slice(3, 2), std::out_of_range);
+    REQUIRE_THROWS_AS(all.slice(0, 11), std::out_of_range);
+    REQUIRE_THROWS_AS(stride.slice(0, 5), std::out_of_range);
+    REQUIRE_THROWS_AS(stride.select({1, 4}), std::out_of_range);
+    REQUIRE_THROWS_AS(all.stride(0), std::runtime_error);
+
+    // Files are opened only if they hold whole records
+    std::vector<int> entries(10);
+    for (std::size_t i = 0; i < entries.size(); i++) {
+        entries[i] = 10*(i / 5) + i % 5;
+    }
+    auto path = _temp_file("hdc_test_dataset.bin", std::string(
+            reinterpret_cast<const char*>(entries.data()), entries.size()*sizeof(int)));
+    auto file = hdc::DatasetView<int>::open(path, 5);
+    REQUIRE(_has_rows(file, {0, 1}));
+    REQUIRE(file.contiguous() != nullptr);
+    REQUIRE_THROWS_AS(hdc::DatasetView<int>::open(path, 3), std::runtime_error);
+    REQUIRE_THROWS_AS(hdc::DatasetView<int>::open(path, 0), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+/*
+ * Scanning text for a character must give the same results as the standard
+ * algorithms, on every instruction set and from any alignment.
+ */
+TEST_CASE("Text scans") {
+    std::string text;
+    for (int i = 0; i < 1000; i++) {
+        text += (std::rand() % 40 == 0) ? '\n' : char('a' + std::rand() % 26);
+    }
+    _for_each_isa([&]() {
+        for (std::size_t begin : {0, 1, 7, 31}) {
+            for (std::size_t size : {0, 1, 15, 16, 17, 31, 32, 33, 64, 100, 969}) {
+                const char* first = text.data() + begin;
+                const char* last = first + size;
+                for (char c : {'\n', 'e', '#'}) {
+                    REQUIRE(hdc::find_char(first, last, c) == std::find(first, last, c));
+                    REQUIRE(hdc::count_char(first, last, c) ==
+                            std::size_t(std::count(first, last, c)));
+                }
+            }
+        }
+    });
+}
+
+// Symbols of the default normalizer computed one byte at a time
+static std::vector<std::uint8_t> _normalize_reference(const std::string& text, bool collapse) {
+    std::vector<std::uint8_t> symbols;
+    bool last_separator = false;
+    for (unsigned char c : text) {
+        bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        if (letter) {
+            symbols.push_back((c | 0x20) - 'a');
+        }
+        else if (!(collapse && last_separator)) {
+            symbols.push_back(26);
+        }
+        last_separator = !letter;
+    }
+    return symbols;
+}
+
+/*
+ * Normalizing text must give the symbols of the byte by byte reference, on
+ * every instruction set, for whole texts and texts split in chunks.
+ */
+TEST_CASE("Text normalization") {
+    std::string text;
+    for (int i = 0; i < 500; i++) {
+        // Mostly letters, with runs of separators and bytes above 127
+        int kind = std::rand() % 8;
+        text += kind == 0 ? char(std::rand() % 256) :
+                kind == 1 ? ' ' :
+                kind == 2 ? char('A' + std::rand() % 26) :
+                            char('a' + std::rand() % 26);
+    }
+    text += std::string(40, ' ') + "@[`{" + std::string(33, 'z');
+
+    for (bool collapse : {true, false}) {
+        hdc::TextNormalizer normalizer(collapse);
+        auto expected = _normalize_reference(text, collapse);
+        _for_each_isa([&]() {
+            std::vector<std::uint8_t> symbols;
+            normalizer.normalize(text, symbols);
+            REQUIRE(symbols == expected);
+
+            for (std::size_t chunk : {1, 15, 16, 33, 100}) {
+                std::vector<std::uint8_t> chunked;
+                bool last_separator = false;
+                for (std::size_t pos = 0; pos < text.size(); pos += chunk) {
+                    normalizer.normalize(std::string_view(text).substr(pos, chunk),
+                                         chunked, last_separator);
+                }
+                REQUIRE(chunked == expected);
+            }
+        });
+    }
+}